@@ -38,6 +38,7 @@
 #  define _FILE_OFFSET_BITS 64
 #elif ! defined(__LP64__)                        // No point defining Large file for 64 bit
 #  define _LARGEFILE64_SOURCE
+#  define _FILE_OFFSET_BITS 64                   // 64 bits off_t for mmap() windows
 #endif
 
 // S_ISREG & gettimeofday() are not supported by MSVC
@@ -45,14 +46,23 @@
 #  define BMK_LEGACY_TIMER 1
 #endif
 
+// clock_gettime(), sysfs probing and other Linux extensions
+#if defined(__linux__)
+#  define _GNU_SOURCE
+#endif
+
 
 //**************************************
 // Includes
 //**************************************
 #include <stdlib.h>      // malloc
 #include <stdio.h>       // fprintf, fopen, ftello64
+#include <string.h>      // memset
+#include <ctype.h>       // tolower
 #include <sys/types.h>   // stat64
 #include <sys/stat.h>    // stat64
+#include <time.h>        // clock_gettime
+#include <math.h>        // sqrt
 
 // Use ftime() if gettimeofday() is not available on your target
 #if defined(BMK_LEGACY_TIMER)
@@ -68,6 +78,65 @@
 #define DEFAULTCOMPRESSOR COMPRESSOR0
 
 #include "xxhash.h"
+#include "lzjb_format.h"   // LZJB_MATCH_MIN, LZJB_MATCH_MAX : crafted worst case streams
+
+// Concurrent workers need POSIX threads
+#if !defined(_WIN32)
+#  include <pthread.h>
+#  include <unistd.h>    // sysconf
+#  define BMK_THREAD_LOCAL __thread
+#else
+#  define BMK_NO_THREADS 1
+#  define BMK_THREAD_LOCAL __declspec(thread)
+#endif
+
+// Large inputs can be memory mapped, one window at a time
+#if !defined(_WIN32)
+#  include <sys/mman.h>  // mmap, madvise
+#  include <fcntl.h>     // open, posix_fadvise
+#else
+#  define BMK_NO_MMAP 1
+#endif
+
+// Pinning, real time scheduling and frequency readings are Linux only
+#if defined(__linux__)
+#  include <sched.h>        // sched_setaffinity, sched_setscheduler
+#  include <sys/resource.h> // setpriority
+#  include <errno.h>        // errno
+#  include <sys/syscall.h>  // SYS_mbind, SYS_set_mempolicy, SYS_get_mempolicy
+#endif
+
+// NUMA placement calls mbind and set_mempolicy directly, without libnuma
+#if !defined(SYS_mbind) || !defined(SYS_set_mempolicy) || !defined(SYS_get_mempolicy)
+#  define BMK_NO_NUMA 1
+#endif
+
+// Codec plugins are shared objects
+#if !defined(_WIN32)
+#  include <dlfcn.h>     // dlopen, dlsym
+#else
+#  define BMK_NO_PLUGINS 1
+#endif
+#include "fullbench_plugin.h"
+
+// Host fingerprint : cpu brand and features, kernel version
+#if !defined(_WIN32)
+#  include <sys/utsname.h>  // uname
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  include <cpuid.h>        // __get_cpuid, __get_cpuid_count
+#  define BMK_HAS_CPUID 1
+#endif
+
+// Allocation accounting of the codecs (see memstat.h)
+#if defined(MEMSTAT)
+#  include "memstat.h"
+#endif
+
+// clflush is used to produce cold cache conditions when available
+#if defined(__SSE2__)
+#  include <emmintrin.h>  // _mm_clflush, _mm_mfence
+#endif
 
 
 //**************************************
@@ -118,10 +187,63 @@
 #define KNUTH      2654435761U
 #define MAX_MEM    (1984<<20)
 #define DEFAULT_CHUNKSIZE   (4<<20)
+#define MAX_BLOCK_SIZES     32
+
+#define MAP_INPUT_MMAP      1
+#define MAP_INPUT_POPULATE  2
 
 #define ALL_COMPRESSORS 0
 #define ALL_DECOMPRESSORS 0
 
+#define MODE_STANDARD   0
+#define MODE_CACHE      1
+#define MODE_WORKINGSET 2
+#define MODE_TRACE      3
+#define MODE_THREADS    4
+#define MODE_STATS      5
+#define MODE_PAGES      6
+#define MODE_ZFS        7
+#define MODE_MATRIX     8
+#define MODE_ALIGN      9
+#define MODE_WORST      10
+#define MODE_NUMA       11
+#define MODE_MIXED      12
+#define MODE_PARETO     13
+#define MODE_RECORDS    14
+#define MODE_ANTAGONIST 15
+
+#define ALIGN_INPUT         1          // -Ai : misalign the codec input only
+#define ALIGN_OUTPUT        2          // -Ao : misalign the codec output only
+#define ALIGN_BOTH          (ALIGN_INPUT | ALIGN_OUTPUT)
+#define ALIGN_MAX           63
+#define MAX_ALIGN_OFFSETS   64
+
+#define NUMA_MAX_NODES      8
+#define NUMA_ANY            -1         // -N without this node : every node is tried
+
+#define PIN_NONE            -2
+#define PIN_CURRENT         -1         // -P alone : the cpu fullbench started on
+#define NOISY_LOAD          0.5        // load average tolerated besides the benchmark
+#define NOISY_EXIT_CODE     21
+
+#define ANTAGONIST_COPY     1          // -X kinds
+#define ANTAGONIST_CHASE    2
+#define ANTAGONIST_THRASH   4
+#define ANTAGONIST_ALL      (ANTAGONIST_COPY | ANTAGONIST_CHASE | ANTAGONIST_THRASH)
+
+#define STAT_MIN_SAMPLES    5
+#define STAT_MAX_SAMPLES    1000
+#define STAT_SAMPLE_MS      100        // Each sample repeats full passes for at least this long
+#define STAT_MAX_MS         60000      // Stop sampling a codec after this long, even if CI is too wide
+#define STAT_OUTLIER_MADS   3.0        // Samples further than this many MADs from the median are rejected
+#define STAT_DRIFT_WARNING  2.0        // % change of the calibration loop which is reported as drift
+#define CALIBRATION_LOOPS   (1<<24)
+
+#define CACHELINE_SIZE      64
+#define DEFAULT_LLC_SIZE    (8<<20)    // Assumed when sysfs can not tell us
+#define EVICT_LLC_MULTIPLE  4          // Size of the eviction buffer, in LLCs
+#define SWEEP_LLC_MULTIPLE  4          // Largest working set swept, in LLCs
+
 
 //**************************************
 // Local structures
@@ -136,6 +258,9 @@ struct chunkParameters
     /* Holds the LZJB compressed chunks */
     char* compressedLZJBBuffer;
     int   compressedLZJBSize;
+    /* Holds the ZFS lz4 compressed chunks (4 bytes length header) */
+    char* compressedZFSLZ4Buffer;
+    int   compressedZFSLZ4Size;
 };
 
 
@@ -150,17 +275,50 @@ struct chunkParameters
 // Benchmark Parameters
 //**************************************
 static int chunkSize = DEFAULT_CHUNKSIZE;
+static int blockSizes[MAX_BLOCK_SIZES];
+static int nbBlockSizes = 0;
+static int mapInput = 0;
+static int pageMode = 0;
+static int zfsAshift = 12;
+static char* resultFileName = NULL;
+static char* baselineFileName = NULL;
+static char* paretoFileName = NULL;
+static double regressionThreshold = 5.;
+static int alignOffsets[MAX_ALIGN_OFFSETS];
+static int nbAlignOffsets = 0;
+static int alignSides = ALIGN_BOTH;
+static int numaThreadNode = NUMA_ANY;
+static int numaSrcNode = NUMA_ANY;
+static int numaDstNode = NUMA_ANY;
+static int pinCPU = PIN_NONE;
+static int schedFifo = 0;
+static int strictIsolation = 0;
 static int nbIterations = NBLOOPS;
 static int BMK_pause = 0;
 static int compressionTest = 1;
 static int decompressionTest = 1;
 static int compressionAlgo = ALL_COMPRESSORS;
 static int decompressionAlgo = ALL_DECOMPRESSORS;
+static int benchMode = MODE_STANDARD;
+static char* traceFileName = NULL;
+static int nbWorkers = 1;
+static int nbReaders = 0;
+static int nbAntagonists = 1;
+static int antagonistKinds = ANTAGONIST_ALL;
+static int nbWriters = 0;
+static double statTarget = 0.;
 
 
+void BMK_ClearBlockSizes(void)
+{
+    // A later -B replaces the sizes of an earlier one
+    nbBlockSizes = 0;
+}
+
 void BMK_SetBlocksize(int bsize)
 {
     chunkSize = bsize;
+    if (nbBlockSizes < MAX_BLOCK_SIZES) blockSizes[nbBlockSizes++] = bsize;
     if (chunkSize >= 1024)
         DISPLAY("-Using Block Size of %i KB-\n", chunkSize>>10);
     else
@@ -178,6 +336,154 @@ void BMK_SetPause()
     BMK_pause = 1;
 }
 
+void BMK_SetCacheTest()
+{
+    benchMode = MODE_CACHE;
+    DISPLAY("- hot/warm/cold cache tests -\n");
+}
+
+void BMK_SetWorkingSetSweep()
+{
+    benchMode = MODE_WORKINGSET;
+    DISPLAY("- working set sweep -\n");
+}
+
+void BMK_SetNbWorkers(int workers)
+{
+    benchMode = MODE_THREADS;
+    nbWorkers = workers;
+    DISPLAY("- scaling test, up to %i workers -\n", nbWorkers);
+}
+
+void BMK_SetMixedLoad(int readers, int writers)
+{
+    benchMode = MODE_MIXED;
+    nbReaders = readers;
+    nbWriters = writers;
+    DISPLAY("- read latency with %i decompression threads, under %i compression threads -\n", nbReaders, nbWriters);
+}
+
+void BMK_SetAntagonists(int kinds, int count)
+{
+    benchMode = MODE_ANTAGONIST;
+    antagonistKinds = kinds;
+    nbAntagonists = count;
+    DISPLAY("- codecs under memory interference from %i antagonist thread(s) -\n", nbAntagonists);
+}
+
+void BMK_SetStatTarget(double target)
+{
+    benchMode = MODE_STATS;
+    statTarget = target;
+    DISPLAY("- sampling until the 95%% confidence interval is within +/-%.2f%% -\n", statTarget);
+}
+
+void BMK_SetZfsAshift(int ashift)
+{
+    benchMode = MODE_ZFS;
+    zfsAshift = ashift;
+    DISPLAY("- ZFS compression decision, ashift %i -\n", zfsAshift);
+}
+
+void BMK_SetAlignSweep(int sides)
+{
+    benchMode = MODE_ALIGN;
+    alignSides = sides;
+}
+
+void BMK_AddAlignOffset(int offset)
+{
+    if (nbAlignOffsets < MAX_ALIGN_OFFSETS) alignOffsets[nbAlignOffsets++] = offset;
+}
+
+void BMK_SetMatrix()
+{
+    benchMode = MODE_MATRIX;
+    DISPLAY("- compressor x decompressor matrix -\n");
+}
+
+void BMK_SetNuma(int threadNode, int srcNode, int dstNode)
+{
+    // NUMA_ANY : the node of the current cpu for the thread, every node for the buffers
+    benchMode = MODE_NUMA;
+    numaThreadNode = threadNode;
+    numaSrcNode = srcNode;
+    numaDstNode = dstNode;
+    DISPLAY("- NUMA placement of the thread, codec input and codec output -\n");
+}
+
+void BMK_SetPareto(char* fileName)
+{
+    benchMode = MODE_PARETO;
+    paretoFileName = fileName;
+    DISPLAY("- ratio vs throughput Pareto report, gnuplot data in %s -\n", paretoFileName);
+}
+
+void BMK_SetRecordDumps()
+{
+    benchMode = MODE_RECORDS;
+    DISPLAY("- input files are ZFS record dumps -\n");
+}
+
+void BMK_SetResultFile(char* fileName)
+{
+    resultFileName = fileName;
+    DISPLAY("- results saved to %s -\n", resultFileName);
+}
+
+void BMK_SetBaseline(char* fileName)
+{
+    baselineFileName = fileName;
+}
+
+void BMK_SetRegressionThreshold(double threshold)
+{
+    regressionThreshold = threshold;
+}
+
+void BMK_SetPinCPU(int cpu)
+{
+    // cpu == PIN_CURRENT : the cpu fullbench was started on
+    pinCPU = cpu;
+}
+
+void BMK_SetSchedFifo()
+{
+    schedFifo = 1;
+}
+
+void BMK_SetStrictIsolation()
+{
+    strictIsolation = 1;
+}
+
+void BMK_SetTraceFile(char* fileName)
+{
+    benchMode = MODE_TRACE;
+    traceFileName = fileName;
+    DISPLAY("- replaying trace %s -\n", traceFileName);
+}
+
+void BMK_SetPageMode(int mode)
+{
+    // mode < 0 : compare every page mode
+    static const char* modeNames[] = { "4K pages", "mlocked, pre-faulted", "transparent huge pages", "hugetlb pages" };
+    if (mode < 0) { benchMode = MODE_PAGES; DISPLAY("- comparing page sizes and pre-faulting -\n"); return; }
+    pageMode = mode;
+    DISPLAY("- buffers use %s -\n", modeNames[mode]);
+}
+
+void BMK_SetMapInput(int mode)
+{
+#if defined(BMK_NO_MMAP)
+    (void)mode;
+    DISPLAY("- memory mapped input is not supported on this platform -\n");
+#else
+    mapInput = mode;
+    DISPLAY("- memory mapped input%s -\n", (mode == MAP_INPUT_POPULATE) ? ", pre-populated" : "");
+#endif
+}
+
 //*********************************************************
 //  Private functions
 //*********************************************************
@@ -221,6 +527,27 @@ static int BMK_GetMilliSpan( int nTimeStart )
 }
 
 
+static U64 BMK_GetNanoTime()
+{
+  // Monotonic nanosecond clock, used to time individual blocks.
+  // The legacy timer only has millisecond resolution.
+#if defined(BMK_LEGACY_TIMER)
+  return (U64)BMK_GetMilliStart() * 1000000ULL;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (U64)ts.tv_sec * 1000000000ULL + (U64)ts.tv_nsec;
+#endif
+}
+
+
+static U32 BMK_rand(U32* seed)
+{
+  *seed = (*seed * KNUTH) + 2246822519U;
+  return *seed >> 8;
+}
+
+
 static size_t BMK_findMaxMem(U64 requiredMem)
 {
     size_t step = (64U<<20);   // 64 MB
@@ -256,6 +583,63 @@ static U64 BMK_GetFileSize(char* infilename)
 }
 
 
+static size_t BMK_getCacheSize(int level)
+{
+    // Size of the data or unified cache at 'level', as seen by cpu0.
+    // Returns 0 when the topology can not be read.
+#if defined(__linux__)
+    int idx;
+    for (idx=0; idx<16; idx++)
+    {
+        char path[96];
+        char type[32] = "";
+        FILE* f;
+        int lvl = 0;
+        unsigned long size = 0;
+        char unit = 0;
+
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%i/level", idx);
+        f = fopen(path, "r");
+        if (f==NULL) break;
+        if (fscanf(f, "%i", &lvl) != 1) lvl = 0;
+        fclose(f);
+        if (lvl != level) continue;
+
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%i/type", idx);
+        f = fopen(path, "r");
+        if (f==NULL) continue;
+        if (fscanf(f, "%31s", type) != 1) type[0] = 0;
+        fclose(f);
+        if (!strcmp(type, "Instruction")) continue;
+
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%i/size", idx);
+        f = fopen(path, "r");
+        if (f==NULL) continue;
+        if (fscanf(f, "%lu%c", &size, &unit) < 1) size = 0;
+        fclose(f);
+        if (unit=='K') size <<= 10;
+        if (unit=='M') size <<= 20;
+        return (size_t)size;
+    }
+#else
+    (void)level;
+#endif
+    return 0;
+}
+
+
+static size_t BMK_getLLCSize()
+{
+    int level;
+    for (level=4; level>0; level--)
+    {
+        size_t size = BMK_getCacheSize(level);
+        if (size) return size;
+    }
+    return DEFAULT_LLC_SIZE;
+}
+
+
 //*********************************************************
 //  Public function
 //*********************************************************
@@ -265,7 +649,7 @@ static inline int local_LZ4_compress_limitedOutput(const char* in, char* out, in
     return LZ4_compress_limitedOutput(in, out, inSize, LZ4_compressBound(inSize));
 }
 
-static void* ctx;
+static BMK_THREAD_LOCAL void* ctx;   // one per worker thread
 static inline int local_LZ4_compress_continue(const char* in, char* out, int inSize)
 {
     return LZ4_compress_continue(ctx, in, out, inSize);
@@ -311,17 +695,28 @@ static inline int local_LZ4_decompress_safe_partial(const char* in, char* out, i
 }
 
 /* TODO: add compatibility hook to lzjb compressors/decompressors here */
+/* The ZFS compressors take zio_compress_data()'s d_len as maxOutputSize (-z) */
 extern size_t lzjb_compress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+static inline int local_LZJB_compress_zfs_limitedOutput(const char* in, char* out, int inSize, int maxOutputSize)
+{
+  return lzjb_compress((void*)in, (void*)out, inSize, maxOutputSize, 0);
+}
+
 static inline int local_LZJB_compress_zfs(const char* in, char* out, int inSize)
 {
-  return lzjb_compress((void*)in, (void*)out, inSize, LZ4_compressBound(chunkSize), 0);
+  return local_LZJB_compress_zfs_limitedOutput(in, out, inSize, LZ4_compressBound(chunkSize));
 }
 
 /*extern size_t lzjb_compress_hack(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);*/
-static inline int local_LZJB_compress_hack(const char* in, char* out, int inSize)
+static inline int local_LZJB_compress_hack_limitedOutput(const char* in, char* out, int inSize, int maxOutputSize)
 {
   /* Place holder for a potentially improved compressor */
-  return lzjb_compress((void*)in, (void*)out, inSize, LZ4_compressBound(chunkSize), 0);
+  return lzjb_compress((void*)in, (void*)out, inSize, maxOutputSize, 0);
+}
+
+static inline int local_LZJB_compress_hack(const char* in, char* out, int inSize)
+{
+  return local_LZJB_compress_hack_limitedOutput(in, out, inSize, LZ4_compressBound(chunkSize));
 }
 
 extern int lzjb_decompress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
@@ -354,9 +749,14 @@ static inline int local_LZJB_decompress_hack(const char* in, char* out, int inSi
 }
 
 extern size_t lz4_compress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+static inline int local_LZ4_compress_zfs_limitedOutput(const char* in, char* out, int inSize, int maxOutputSize)
+{
+  return lz4_compress((void*)in, (void*)out, inSize, maxOutputSize, 0);
+}
+
 static inline int local_LZ4_compress_zfs(const char* in, char* out, int inSize)
 {
-  return lz4_compress((void*)in, (void*)out, inSize, LZ4_compressBound(chunkSize), 0);
+  return local_LZ4_compress_zfs_limitedOutput(in, out, inSize, LZ4_compressBound(chunkSize));
 }
 
 extern void lz4_init(void);
@@ -377,6 +777,228 @@ static inline int local_LZ4_decompress_zfs(const char* in, char* out, int inSize
   return outSize;
 }
 
+//*********************************************************
+//  Codec tables
+//*********************************************************
+// Plugins (-L) take the slots after the built-in codecs
+#define MAX_PLUGINS 4
+#define NB_BUILTIN_COMPRESSORS 5
+#define NB_COMPRESSION_ALGORITHMS (NB_BUILTIN_COMPRESSORS + MAX_PLUGINS)
+#define FIRST_LZJB_COMP 3
+#define MINCOMPRESSIONCHAR '0'
+#define MAXCOMPRESSIONCHAR (MINCOMPRESSIONCHAR + NB_COMPRESSION_ALGORITHMS)
+static char* compressionNames[NB_COMPRESSION_ALGORITHMS] = { "LZ4_compress",
+    /*
+                                    "LZ4_compress_limitedOutput",
+                                    "LZ4_compress_continue",
+                                    "LZ4_compress_limitedOutput_continue",
+  */
+                                    "LZ4_compressHC",
+  /*
+                                    "LZ4_compressHC_limitedOutput",
+                                    "LZ4_compressHC_continue",
+                                    "LZ4_compressHC_limitedOutput_continue",
+  */
+                                    "ZFS_lz4_compress",
+                                    "ZFS_lzjb_compress",
+                                    "HAX_lzjb_compress" };
+
+/* TODO: INCREASE THIS FOR EACH NEW DECOMPRESSOR */
+#define NB_BUILTIN_DECOMPRESSORS 5
+#define NB_DECOMPRESSION_ALGORITHMS (NB_BUILTIN_DECOMPRESSORS + MAX_PLUGINS)
+#define MINDECOMPRESSIONCHAR '0'
+#define MAXDECOMPRESSIONCHAR (MINDECOMPRESSIONCHAR + NB_DECOMPRESSION_ALGORITHMS)
+/* TODO: ADD A DECOMPRESSOR LABEL HERE */
+static char* decompressionNames[NB_DECOMPRESSION_ALGORITHMS] = { "LZ4_decompress_fast",
+    /*
+                                      "LZ4_decompress_fast_withPrefix64k",
+                                      "LZ4_decompress_safe",
+                                      "LZ4_decompress_safe_withPrefix64k",
+                                      "LZ4_decompress_safe_partial",
+      */
+                                      "ZFS_lz4_decompress",
+                                      "ZFS_lzjb_decompress",
+                                      "BSD_lzjb_decompress",
+                                      "HAX lzjb_decompress" };
+
+// Stream formats : a compressor feeds every decompressor of its format.
+// ZFS lz4 streams start with a 4 bytes length, so they are not plain LZ4.
+#define FORMAT_LZ4      FULLBENCH_FORMAT_LZ4
+#define FORMAT_ZFS_LZ4  FULLBENCH_FORMAT_ZFS_LZ4
+#define FORMAT_LZJB     FULLBENCH_FORMAT_LZJB
+#define NB_FORMATS      3
+static char* formatNames[] = { "LZ4", "ZFS lz4", "LZJB" };
+static int compressionFormats[NB_COMPRESSION_ALGORITHMS] = { FORMAT_LZ4, FORMAT_LZ4, FORMAT_ZFS_LZ4, FORMAT_LZJB, FORMAT_LZJB };
+static int decompressionFormats[NB_DECOMPRESSION_ALGORITHMS] = { FORMAT_LZ4, FORMAT_ZFS_LZ4, FORMAT_LZJB, FORMAT_LZJB, FORMAT_LZJB };
+
+typedef int   (*compressor_t)(const char*, char*, int);
+typedef int   (*limitedCompressor_t)(const char*, char*, int, int);
+typedef int   (*decompressor_t)(const char*, char*, int, int);
+typedef void* (*initializer_t)(const char*);
+
+// Loaded plugins, see fullbench_plugin.h
+static const fullbench_plugin_t* plugins[MAX_PLUGINS];
+static int nbPlugins = 0;
+
+// Plugin compressors are given their output capacity, or the ZFS limit through
+// the limitedOutput adapter; two adapters per slot
+#define BMK_PLUGIN_COMPRESSOR(n) \
+    static int BMK_pluginCompress##n(const char* in, char* out, int inSize) \
+    { return plugins[n]->compress(in, out, inSize, LZ4_compressBound(inSize)); } \
+    static int BMK_pluginCompress##n##_limitedOutput(const char* in, char* out, int inSize, int maxOutputSize) \
+    { return plugins[n]->compress(in, out, inSize, maxOutputSize); }
+BMK_PLUGIN_COMPRESSOR(0)
+BMK_PLUGIN_COMPRESSOR(1)
+BMK_PLUGIN_COMPRESSOR(2)
+BMK_PLUGIN_COMPRESSOR(3)
+static const compressor_t pluginCompressors[MAX_PLUGINS] = { BMK_pluginCompress0, BMK_pluginCompress1, BMK_pluginCompress2, BMK_pluginCompress3 };
+static const limitedCompressor_t pluginLimitedCompressors[MAX_PLUGINS] = { BMK_pluginCompress0_limitedOutput, BMK_pluginCompress1_limitedOutput,
+                                                                          BMK_pluginCompress2_limitedOutput, BMK_pluginCompress3_limitedOutput };
+
+static int BMK_pluginCompressor(int pluginNb, compressor_t* compressionFunction)
+{
+    const fullbench_plugin_t* p;
+    if ((pluginNb < 0) || (pluginNb >= nbPlugins) || (plugins[pluginNb]->compress == NULL)) { DISPLAY("ERROR ! Bad algorithm Id !! \n"); return 1; }
+    p = plugins[pluginNb];
+    // Blocks are given LZ4_compressBound() bytes of output, like the built-in codecs
+    if ((p->bound != NULL) && (p->bound(chunkSize) > LZ4_compressBound(chunkSize)))
+    {
+        DISPLAY("ERROR ! %s needs %i bytes for %i bytes blocks, fullbench gives %i !! \n", p->name, p->bound(chunkSize), chunkSize, LZ4_compressBound(chunkSize));
+        return 1;
+    }
+    *compressionFunction = pluginCompressors[pluginNb];
+    return 0;
+}
+
+static int BMK_pluginDecompressor(int pluginNb, decompressor_t* decompressionFunction)
+{
+    if ((pluginNb < 0) || (pluginNb >= nbPlugins) || (plugins[pluginNb]->decompress == NULL)) { DISPLAY("ERROR ! Bad algorithm Id !! \n"); return 1; }
+    *decompressionFunction = plugins[pluginNb]->decompress;
+    return 0;
+}
+
+int BMK_LoadPlugin(char* fileName)
+{
+    // Plugins stay loaded until exit; their codecs take the next free slots
+#if defined(BMK_NO_PLUGINS)
+    DISPLAY("Error: codec plugins are not supported on this platform (%s)\n", fileName);
+    return 1;
+#else
+    void* handle;
+    fullbench_plugin_entry_t entry;
+    const fullbench_plugin_t* p;
+    int algNb, cAlgNb = NB_BUILTIN_COMPRESSORS + nbPlugins, dAlgNb = NB_BUILTIN_DECOMPRESSORS + nbPlugins;
+
+    if (nbPlugins == MAX_PLUGINS) { DISPLAY("Error: at most %i plugins can be loaded\n", MAX_PLUGINS); return 1; }
+    handle = dlopen(fileName, RTLD_NOW | RTLD_LOCAL);
+    if (handle==NULL) { DISPLAY("Error: can not load plugin %s (%s)\n", fileName, dlerror()); return 1; }
+    *(void**)(&entry) = dlsym(handle, FULLBENCH_PLUGIN_ENTRY);     // ISO C has no function pointer cast from void*
+    p = (entry != NULL) ? entry() : NULL;
+    if (p == NULL) { DISPLAY("Error: %s does not export %s()\n", fileName, FULLBENCH_PLUGIN_ENTRY); dlclose(handle); return 1; }
+    if (p->version != FULLBENCH_PLUGIN_VERSION) { DISPLAY("Error: %s is plugin version %i, fullbench needs %i\n", fileName, p->version, FULLBENCH_PLUGIN_VERSION); dlclose(handle); return 1; }
+    if ((p->name == NULL) || (p->name[0] == 0) || (strlen(p->name) > 31) || (p->format < 0) || (p->format >= NB_FORMATS) || ((p->compress == NULL) && (p->decompress == NULL)))
+    {
+        DISPLAY("Error: %s : invalid name, format or codec\n", fileName);
+        dlclose(handle);
+        return 1;
+    }
+    for (algNb=0; algNb<NB_COMPRESSION_ALGORITHMS; algNb++)
+        if ((compressionNames[algNb] && !strcmp(compressionNames[algNb], p->name)) || (decompressionNames[algNb] && !strcmp(decompressionNames[algNb], p->name)))
+        {
+            DISPLAY("Error: %s : codec name %s is already used\n", fileName, p->name);
+            dlclose(handle);
+            return 1;
+        }
+    if ((p->init != NULL) && p->init()) { DISPLAY("Error: %s : init() failed\n", fileName); dlclose(handle); return 1; }
+
+    plugins[nbPlugins++] = p;
+    if (p->compress != NULL) { compressionNames[cAlgNb] = (char*)p->name; compressionFormats[cAlgNb] = p->format; }
+    if (p->decompress != NULL) { decompressionNames[dAlgNb] = (char*)p->name; decompressionFormats[dAlgNb] = p->format; }
+    DISPLAY("- plugin %s : %s, %s format", fileName, p->name, formatNames[p->format]);
+    if (p->compress != NULL) DISPLAY(", compressor %c", MINCOMPRESSIONCHAR + cAlgNb);
+    if (p->decompress != NULL) DISPLAY(", decompressor %c", MINDECOMPRESSIONCHAR + dAlgNb);
+    DISPLAY(" -\n");
+    return 0;
+#endif
+}
+
+static int BMK_selectCompressor(int cAlgNb, compressor_t* compressionFunction, initializer_t* initFunction)
+{
+    *initFunction = NULL;
+    switch(cAlgNb)
+    {
+    case 0: *compressionFunction = LZ4_compress; break;
+/*  case 1: *compressionFunction = local_LZ4_compress_limitedOutput; break;
+    case 2: *compressionFunction = local_LZ4_compress_continue; *initFunction = LZ4_create; break;
+    case 3: *compressionFunction = local_LZ4_compress_limitedOutput_continue; *initFunction = LZ4_create; break;
+*/
+    case 1: *compressionFunction = LZ4_compressHC; break;
+/*
+    case 5: *compressionFunction = local_LZ4_compressHC_limitedOutput; break;
+    case 6: *compressionFunction = local_LZ4_compressHC_continue; *initFunction = LZ4_createHC; break;
+    case 7: *compressionFunction = local_LZ4_compressHC_limitedOutput_continue; *initFunction = LZ4_createHC; break;
+*/
+    case 2: *compressionFunction = local_LZ4_compress_zfs; *initFunction = local_LZ4_compress_zfs_init; break;
+    case 3: *compressionFunction = local_LZJB_compress_zfs; break;
+    case 4: *compressionFunction = local_LZJB_compress_hack; break;
+    default :
+        if (BMK_pluginCompressor(cAlgNb - NB_BUILTIN_COMPRESSORS, compressionFunction)) return 1;
+        break;
+    }
+    return 0;
+}
+
+static limitedCompressor_t BMK_limitedCompressor(int cAlgNb)
+{
+    // The same compressor with a maxOutputSize argument, ZFS formats only (NULL otherwise)
+    switch(cAlgNb)
+    {
+    case 2: return local_LZ4_compress_zfs_limitedOutput;
+    case 3: return local_LZJB_compress_zfs_limitedOutput;
+    case 4: return local_LZJB_compress_hack_limitedOutput;
+    default :
+        if (compressionFormats[cAlgNb] == FORMAT_LZ4) return NULL;
+        return pluginLimitedCompressors[cAlgNb - NB_BUILTIN_COMPRESSORS];
+    }
+}
+
+static int BMK_selectDecompressor(int dAlgNb, decompressor_t* decompressionFunction)
+{
+    switch(dAlgNb)
+    {
+    case 0: *decompressionFunction = local_LZ4_decompress_fast; break;
+/*
+    case 1: *decompressionFunction = local_LZ4_decompress_fast_withPrefix64k; break;
+    case 2: *decompressionFunction = LZ4_decompress_safe; break;
+    case 3: *decompressionFunction = LZ4_decompress_safe_withPrefix64k; break;
+    case 4: *decompressionFunction = local_LZ4_decompress_safe_partial; break;
+*/
+    /* TODO: ADD NEW DECOMPRESSORS HERE */
+    case 1: *decompressionFunction = local_LZ4_decompress_zfs; break;
+
+    case 2: *decompressionFunction = local_LZJB_decompress_original; break;
+    case 3: *decompressionFunction = local_LZJB_decompress_bsd; break;
+    case 4: *decompressionFunction = local_LZJB_decompress_hack; break;
+
+    default :
+        if (BMK_pluginDecompressor(dAlgNb - NB_BUILTIN_DECOMPRESSORS, decompressionFunction)) return 1;
+        break;
+    }
+    return 0;
+}
+
+static int BMK_compressorSelected(int cAlgNb)
+{
+    if (compressionNames[cAlgNb] == NULL) return 0;     // free plugin slot
+    return (compressionAlgo == ALL_COMPRESSORS) || (compressionAlgo & (1 << cAlgNb));
+}
+
+static int BMK_decompressorSelected(int dAlgNb)
+{
+    if (decompressionNames[dAlgNb] == NULL) return 0;
+    return (decompressionAlgo == ALL_DECOMPRESSORS) || (decompressionAlgo & (1 << dAlgNb));
+}
+
 void hexdump(unsigned char *buffer, int index, int long width, int error, uint64_t offset)
 {
   int i;
@@ -458,330 +1080,4239 @@ void compareBufferToFile(void* buf, int size, char* inFileName, int offset)
     }
 }
 
-int fullSpeedBench(char** fileNamesTable, int nbFiles)
+static void BMK_initChunks(struct chunkParameters* chunkP, int nbChunks, char* orig_buff, size_t benchedSize, char* compressed_buff, char* compressed_LZJBbuff, char* compressed_ZFSLZ4buff)
 {
-  int fileIdx=0;
-  char* orig_buff;
-# define NB_COMPRESSION_ALGORITHMS 5
-# define FIRST_LZJB_COMP 3
-# define MINCOMPRESSIONCHAR '0'
-# define MAXCOMPRESSIONCHAR (MINCOMPRESSIONCHAR + NB_COMPRESSION_ALGORITHMS)
-  static char* compressionNames[] = { "LZ4_compress",
-      /*
-                                      "LZ4_compress_limitedOutput",
-                                      "LZ4_compress_continue",
-                                      "LZ4_compress_limitedOutput_continue",
-    */
-                                      "LZ4_compressHC",
-    /*
-                                      "LZ4_compressHC_limitedOutput",
-                                      "LZ4_compressHC_continue",
-                                      "LZ4_compressHC_limitedOutput_continue",
-    */
-                                      "ZFS_lz4_compress",
-                                      "ZFS_lzjb_compress",
-                                      "HAX_lzjb_compress" };
-
-  double totalCTime[NB_COMPRESSION_ALGORITHMS] = {0};
-  double totalCSize[NB_COMPRESSION_ALGORITHMS] = {0};
-
-  /* TODO: INCREASE THIS FOR EACH NEW DECOMPRESSOR */
-# define NB_DECOMPRESSION_ALGORITHMS 5
-# define MINDECOMPRESSIONCHAR '0'
-# define MAXDECOMPRESSIONCHAR (MINDECOMPRESSIONCHAR + NB_DECOMPRESSION_ALGORITHMS)
-# define FIRST_LZJB_DECO 2
-  /* TODO: ADD A DECOMPRESSOR LABEL HERE */
-  static char* decompressionNames[] = { "LZ4_decompress_fast",
-      /*
-                                        "LZ4_decompress_fast_withPrefix64k",
-                                        "LZ4_decompress_safe",
-                                        "LZ4_decompress_safe_withPrefix64k",
-                                        "LZ4_decompress_safe_partial",
-        */
-                                        "ZFS_lz4_decompress",
-                                        "ZFS_lzjb_decompress",
-                                        "BSD_lzjb_decompress",
-                                        "HAX lzjb_decompress" };
-  double totalDTime[NB_DECOMPRESSION_ALGORITHMS] = {0};
-
-  U64 totals = 0;
+    int i;
+    int maxCompressedChunkSize = LZ4_compressBound(chunkSize);
+    size_t remaining = benchedSize;
+    char* in = orig_buff;
+    char* out = compressed_buff;
+    char* outz = compressed_LZJBbuff;
+    char* out4 = compressed_ZFSLZ4buff;
+    for (i=0; i<nbChunks; i++)
+    {
+        chunkP[i].id = i;
+        chunkP[i].origBuffer = in; in += chunkSize;
+        if ((int)remaining > chunkSize) { chunkP[i].origSize = chunkSize; remaining -= chunkSize; } else { chunkP[i].origSize = (int)remaining; remaining = 0; }
+        chunkP[i].compressedBuffer = out; out += maxCompressedChunkSize;
+        chunkP[i].compressedSize = 0;
+        chunkP[i].compressedLZJBBuffer = outz; outz += maxCompressedChunkSize;
+        chunkP[i].compressedLZJBSize = 0;
+        chunkP[i].compressedZFSLZ4Buffer = out4; out4 += maxCompressedChunkSize;
+        chunkP[i].compressedZFSLZ4Size = 0;
+    }
+}
 
+static void BMK_prepareDecompression(struct chunkParameters* chunkP, int nbChunks)
+{
+    // One reference stream per format : decoders are fed the one of their format
+    int chunkNb;
+    for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+    {
+        chunkP[chunkNb].compressedSize = LZ4_compress(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize);
+        if (chunkP[chunkNb].compressedSize==0) DISPLAY("ERROR in chunk (%d) ! %s() = 0 !! \n", chunkNb, compressionNames[0]), exit(1);
 
-  // Loop for each file
-  while (fileIdx<nbFiles)
-  {
-      FILE* inFile;
-      char* inFileName;
-      U64   inFileSize;
-      size_t benchedSize;
-      int nbChunks;
-      int maxCompressedChunkSize;
-      struct chunkParameters* chunkP;
-      size_t readSize;
-      char* compressed_buff; int compressedBuffSize;
-      char* compressed_LZJBbuff; int compressedLZJBBuffSize;
-      U32 crcOriginal;
-
-      // Check file existence
-      inFileName = fileNamesTable[fileIdx++];
-      inFile = fopen( inFileName, "rb" );
-      if (inFile==NULL)
-      {
-        DISPLAY( "Problem opening %s\n", inFileName);
-        return 11;
-      }
+        /* Original ZFS lzjb is not safe on all data streams, it seems.  use the "Safe" version. */
+        chunkP[chunkNb].compressedLZJBSize = local_LZJB_compress_zfs(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedLZJBBuffer, chunkP[chunkNb].origSize);
+        if (chunkP[chunkNb].compressedLZJBSize==0) DISPLAY("ERROR in chunk (%d,%d) ! %s() = 0 !! \n", chunkNb, chunkP[chunkNb].origSize, compressionNames[FIRST_LZJB_COMP]), exit(1);
 
-      // Memory allocation & restrictions
-      inFileSize = BMK_GetFileSize(inFileName);
-      benchedSize = (size_t) BMK_findMaxMem(inFileSize) / 2;
-      if ((U64)benchedSize > inFileSize) benchedSize = (size_t)inFileSize;
-      if (benchedSize < inFileSize)
-      {
-          DISPLAY("Not enough memory for '%s' full size; testing %i MB only...\n", inFileName, (int)(benchedSize>>20));
-      }
+        chunkP[chunkNb].compressedZFSLZ4Size = local_LZ4_compress_zfs(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedZFSLZ4Buffer, chunkP[chunkNb].origSize);
+        if (chunkP[chunkNb].compressedZFSLZ4Size==0) DISPLAY("ERROR in chunk (%d,%d) ! %s() = 0 !! \n", chunkNb, chunkP[chunkNb].origSize, compressionNames[2]), exit(1);
+    }
+}
 
-      // Alloc
-      chunkP = (struct chunkParameters*) malloc(((benchedSize / chunkSize)+1) * sizeof(struct chunkParameters));
+static inline char* BMK_referenceStream(struct chunkParameters* chunk, int format, int** size)
+{
+    // Compressed buffer of a chunk holding the stream of this format
+    switch(format)
+    {
+    case FORMAT_LZJB:    *size = &chunk->compressedLZJBSize; return chunk->compressedLZJBBuffer;
+    case FORMAT_ZFS_LZ4: *size = &chunk->compressedZFSLZ4Size; return chunk->compressedZFSLZ4Buffer;
+    default:             *size = &chunk->compressedSize; return chunk->compressedBuffer;
+    }
+}
 
-      orig_buff = (char*) malloc((size_t)benchedSize);
-      nbChunks = (int) (benchedSize / chunkSize);
-      if ((size_t)(chunkSize * nbChunks) < benchedSize) nbChunks++; /* Handle odd sized end chunks, and chunk aligned data */
-      maxCompressedChunkSize = LZ4_compressBound(chunkSize);
-      compressedBuffSize = nbChunks * maxCompressedChunkSize;
-      compressed_buff = (char*)malloc((size_t)compressedBuffSize);
-      compressedLZJBBuffSize = nbChunks * maxCompressedChunkSize;
-      compressed_LZJBbuff = (char*)malloc((size_t)compressedLZJBBuffSize);
+static inline int BMK_decompressChunk(int dAlgNb, decompressor_t decompressionFunction, struct chunkParameters* chunk)
+{
+    int* size;
+    char* stream = BMK_referenceStream(chunk, decompressionFormats[dAlgNb], &size);
+    return decompressionFunction(stream, chunk->origBuffer, *size, chunk->origSize);
+}
 
+//*********************************************************
+//  Cache temperature benchmark
+//*********************************************************
+#define CACHE_HOT   0    // block processed again immediately after a first, untimed, run
+#define CACHE_WARM  1    // blocks in random order, caches left as previous blocks leave them
+#define CACHE_COLD  2    // blocks in random order, block buffers flushed from every cache level
+#define NB_CACHE_MODES 3
+static char* cacheModeNames[] = { "hot", "warm", "cold" };
 
-      if(!orig_buff || !compressed_buff || !compressed_LZJBbuff)
-      {
-        DISPLAY("\nError: not enough memory!\n");
-        free(orig_buff);
-        free(compressed_buff);
-        free(chunkP);
-        fclose(inFile);
-        return 12;
-      }
+#if !defined(__SSE2__)
+static BYTE*  evictBuffer = NULL;
+static size_t evictBufferSize = 0;
 
-      // Init chunks data
-      {
-          int i;
-          size_t remaining = benchedSize;
-          char* in = orig_buff;
-          char* out = compressed_buff;
-          char* outz = compressed_LZJBbuff;
-          for (i=0; i<nbChunks; i++)
-          {
-              chunkP[i].id = i;
-              chunkP[i].origBuffer = in; in += chunkSize;
-              if ((int)remaining > chunkSize) { chunkP[i].origSize = chunkSize; remaining -= chunkSize; } else { chunkP[i].origSize = (int)remaining; remaining = 0; }
-              chunkP[i].compressedBuffer = out; out += maxCompressedChunkSize;
-              chunkP[i].compressedSize = 0;
-              chunkP[i].compressedLZJBBuffer = outz; outz += maxCompressedChunkSize;
-              chunkP[i].compressedLZJBSize = 0;
-          }
-      }
+static void BMK_evictCaches()
+{
+    // Stream through a buffer several times larger than the LLC,
+    // pushing everything else out of every cache level.
+    size_t i;
+    if (evictBuffer==NULL)
+    {
+        evictBufferSize = BMK_getLLCSize() * EVICT_LLC_MULTIPLE;
+        evictBuffer = (BYTE*) malloc(evictBufferSize);
+        if (evictBuffer==NULL) { DISPLAY("\nError: not enough memory for eviction buffer!\n"); exit(12); }
+    }
+    for (i=0; i<evictBufferSize; i+=CACHELINE_SIZE) evictBuffer[i]++;
+}
+#endif
 
-      // Fill input buffer
-      DISPLAY("Loading %s...       \r", inFileName);
-      readSize = fread(orig_buff, 1, benchedSize, inFile);
-      fclose(inFile);
+static void BMK_flushRange(const void* ptr, size_t size)
+{
+#if defined(__SSE2__)
+    const char* p = (const char*)((size_t)ptr & ~(size_t)(CACHELINE_SIZE-1));
+    const char* const end = (const char*)ptr + size;
+    for ( ; p < end; p += CACHELINE_SIZE) _mm_clflush(p);
+    _mm_mfence();
+#else
+    (void)ptr; (void)size;
+    BMK_evictCaches();
+#endif
+}
 
-      if(readSize != benchedSize)
-      {
-        DISPLAY("\nError: problem reading file '%s' !!    \n", inFileName);
-        free(orig_buff);
-        free(compressed_buff);
-        free(chunkP);
-        return 13;
-      }
+static void BMK_shuffle(int* order, int nbChunks, U32* seed)
+{
+    int i;
+    for (i=nbChunks-1; i>0; i--)
+    {
+        int j = (int)(BMK_rand(seed) % (U32)(i+1));
+        int t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+}
 
-      // Calculating input Checksum
-      crcOriginal = XXH32(orig_buff, (unsigned int)benchedSize,0);
+static int BMK_runChunk(compressor_t compressionFunction, int dAlgNb, decompressor_t decompressionFunction, struct chunkParameters* chunk)
+{
+    if (compressionFunction!=NULL)
+        return chunk->compressedSize = compressionFunction(chunk->origBuffer, chunk->compressedBuffer, chunk->origSize);
+    return BMK_decompressChunk(dAlgNb, decompressionFunction, chunk);
+}
 
+static void BMK_flushChunk(int decode, int dAlgNb, struct chunkParameters* chunk)
+{
+    BMK_flushRange(chunk->origBuffer, chunk->origSize);
+    if (!decode)
+        BMK_flushRange(chunk->compressedBuffer, LZ4_compressBound(chunk->origSize));
+    else
+    {
+        int* size;
+        char* stream = BMK_referenceStream(chunk, decompressionFormats[dAlgNb], &size);
+        BMK_flushRange(stream, *size);
+    }
+}
 
-      // Bench
-      {
-        int loopNb, nb_loops, chunkNb, cAlgNb, dAlgNb;
-        size_t cSize=0;
-        double ratio=0.;
+static double BMK_cacheModeSpeed(int decode, int algNb, int mode, struct chunkParameters* chunkP, int nbChunks, int* order, char* inFileName)
+{
+    // Returns the best throughput (MB/s) of one codec under one cache condition.
+    // Each block is timed individually, so cache preparation is never counted.
+    char* name = decode ? decompressionNames[algNb] : compressionNames[algNb];
+    compressor_t compressionFunction = NULL;
+    initializer_t initFunction = NULL;
+    decompressor_t decompressionFunction = NULL;
+    U32 seed = KNUTH;
+    double bestSpeed = 0.;
+    int loopNb;
+
+    if (decode) { if (BMK_selectDecompressor(algNb, &decompressionFunction)) exit(1); }
+    else if (BMK_selectCompressor(algNb, &compressionFunction, &initFunction)) exit(1);
+
+    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+    {
+        U64 bytes = 0, nanos = 0;
+        double speed;
+        int milliTime;
 
-        DISPLAY("\r%79s\r", "");
-        DISPLAY(" %s : \n", inFileName);
+        DISPLAY("%1i-%-21.21s : %-4s\r", loopNb, name, cacheModeNames[mode]);
 
-        // Compression Algorithms
-        for (cAlgNb=0; (cAlgNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); cAlgNb++)
+        milliTime = BMK_GetMilliStart();
+        do
         {
-            char* cName = compressionNames[cAlgNb];
-            int (*compressionFunction)(const char*, char*, int);
-            void* (*initFunction)(const char*) = NULL;
-            double bestTime = 100000000.;
+            int i;
+            if (mode != CACHE_HOT) BMK_shuffle(order, nbChunks, &seed);
+            if (initFunction!=NULL) ctx = initFunction(chunkP[0].origBuffer);
+            for (i=0; i<nbChunks; i++)
+            {
+                struct chunkParameters* chunk = &chunkP[(mode==CACHE_HOT) ? i : order[i]];
+                U64 start;
+                int result;
+
+                if (mode==CACHE_HOT) BMK_runChunk(compressionFunction, algNb, decompressionFunction, chunk);
+                if (mode==CACHE_COLD) BMK_flushChunk(decode, algNb, chunk);
+
+                start = BMK_GetNanoTime();
+                result = BMK_runChunk(compressionFunction, algNb, decompressionFunction, chunk);
+                nanos += BMK_GetNanoTime() - start;
+
+                if ((!decode) && (result==0)) DISPLAY("ERROR ! %s() = 0 !! \n", name), exit(1);
+                if ((decode) && (result!=chunk->origSize))
+                {
+                    DISPLAY("ERROR @ Chunk %i ! %s() == %i != %i !! \n", (int)chunk->id, name, result, chunk->origSize);
+                    compareBufferToFile(chunk->origBuffer, result, inFileName, chunk->id*chunkSize);
+                    exit(1);
+                }
+                bytes += chunk->origSize;
+            }
+            if (initFunction!=NULL) free(ctx);
+        } while (BMK_GetMilliSpan(milliTime) < TIMELOOP);
+
+        speed = nanos ? (double)bytes * 1000. / (double)nanos : 0.;
+        if (speed > bestSpeed) bestSpeed = speed;
+    }
+
+    return bestSpeed;
+}
+
+static int BMK_cacheBench(char* inFileName, struct chunkParameters* chunkP, int nbChunks, char* orig_buff, size_t benchedSize, U32 crcOriginal)
+{
+    int* order = (int*) malloc(nbChunks * sizeof(int));
+    int algNb, mode, i;
+
+    if (order==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+    for (i=0; i<nbChunks; i++) order[i] = i;
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i blocks of %i KB\n", inFileName, nbChunks, chunkSize>>10);
+#if defined(__SSE2__)
+    DISPLAY("cold blocks are flushed with clflush (LLC %i KB)\n", (int)(BMK_getLLCSize()>>10));
+#else
+    DISPLAY("cold blocks are evicted with a %i KB streaming buffer\n", (int)((BMK_getLLCSize()*EVICT_LLC_MULTIPLE)>>10));
+#endif
+    DISPLAY("%-23.23s : %10s %10s %10s\n", "(MB/s)", cacheModeNames[CACHE_HOT], cacheModeNames[CACHE_WARM], cacheModeNames[CACHE_COLD]);
+
+    for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+    {
+        double speed[NB_CACHE_MODES];
+        if (!BMK_compressorSelected(algNb)) continue;
+        for (mode=0; mode<NB_CACHE_MODES; mode++)
+            speed[mode] = BMK_cacheModeSpeed(0, algNb, mode, chunkP, nbChunks, order, inFileName);
+        DISPLAY("%-23.23s : %10.1f %10.1f %10.1f\n", compressionNames[algNb], speed[CACHE_HOT], speed[CACHE_WARM], speed[CACHE_COLD]);
+    }
+
+    BMK_prepareDecompression(chunkP, nbChunks);
+    if (decompressionTest) memset(orig_buff, 0, benchedSize);     // zeroing source area, for CRC checking
+
+    for (algNb=0; (algNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); algNb++)
+    {
+        double speed[NB_CACHE_MODES];
+        U32 crcDecoded;
+        if (!BMK_decompressorSelected(algNb)) continue;
+        for (mode=0; mode<NB_CACHE_MODES; mode++)
+            speed[mode] = BMK_cacheModeSpeed(1, algNb, mode, chunkP, nbChunks, order, inFileName);
+        DISPLAY("%-23.23s : %10.1f %10.1f %10.1f\n", decompressionNames[algNb], speed[CACHE_HOT], speed[CACHE_WARM], speed[CACHE_COLD]);
+
+        crcDecoded = XXH32(orig_buff, (int)benchedSize, 0);
+        if (crcOriginal!=crcDecoded)
+        {
+            DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOriginal, (unsigned)crcDecoded);
+            compareBufferToFile(orig_buff, benchedSize, inFileName, 0);
+        }
+    }
+
+    free(order);
+    return 0;
+}
+
+
+//*********************************************************
+//  Timing loops
+//*********************************************************
+static double BMK_timeChunks(int decode, int algNb, struct chunkParameters* chunkP, int nbChunks, char* inFileName, int milliSeconds)
+{
+    // Throughput (MB/s) of one codec over repeated sequential passes on chunkP,
+    // for at least milliSeconds, exactly as the standard benchmark loop does it.
+    char* name = decode ? decompressionNames[algNb] : compressionNames[algNb];
+    compressor_t compressionFunction = NULL;
+    initializer_t initFunction = NULL;
+    decompressor_t decompressionFunction = NULL;
+    U64 passBytes = 0;
+    U64 nanos;
+    int nb_loops = 0;
+    int milliTime, chunkNb;
+
+    if (decode) { if (BMK_selectDecompressor(algNb, &decompressionFunction)) exit(1); }
+    else if (BMK_selectCompressor(algNb, &compressionFunction, &initFunction)) exit(1);
+    for (chunkNb=0; chunkNb<nbChunks; chunkNb++) passBytes += chunkP[chunkNb].origSize;
+
+    milliTime = BMK_GetMilliStart();
+    while(BMK_GetMilliStart() == milliTime);
+    milliTime = BMK_GetMilliStart();
+    nanos = BMK_GetNanoTime();
+    while(BMK_GetMilliSpan(milliTime) < milliSeconds)
+    {
+        if (initFunction!=NULL) ctx = initFunction(chunkP[0].origBuffer);
+        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+        {
+            struct chunkParameters* chunk = &chunkP[chunkNb];
+            int result = BMK_runChunk(compressionFunction, algNb, decompressionFunction, chunk);
+            if ((!decode) && (result==0)) DISPLAY("ERROR ! %s() = 0 !! \n", name), exit(1);
+            if ((decode) && (result!=chunk->origSize))
+            {
+                DISPLAY("ERROR @ Chunk %i ! %s() == %i != %i !! \n", chunkNb, name, result, chunk->origSize);
+                if (inFileName!=NULL) compareBufferToFile(chunk->origBuffer, result, inFileName, chunk->id*chunkSize);
+                exit(1);
+            }
+        }
+        if (initFunction!=NULL) free(ctx);
+        nb_loops++;
+    }
+    nanos = BMK_GetNanoTime() - nanos;
+
+    return (double)passBytes * nb_loops * 1000. / (double)nanos;
+}
+
+static double BMK_benchChunks(int decode, int algNb, struct chunkParameters* chunkP, int nbChunks, char* inFileName)
+{
+    // Best throughput (MB/s) of nbIterations timing loops
+    char* name = decode ? decompressionNames[algNb] : compressionNames[algNb];
+    double bestSpeed = 0.;
+    int loopNb;
+
+    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+    {
+        double speed;
+        DISPLAY("%1i-%-21.21s :\r", loopNb, name);
+        speed = BMK_timeChunks(decode, algNb, chunkP, nbChunks, inFileName, TIMELOOP);
+        if (speed > bestSpeed) bestSpeed = speed;
+    }
+
+    return bestSpeed;
+}
+
+
+//*********************************************************
+//  Statistical run control
+//*********************************************************
+static volatile U32 calibrationSink;
+
+static double BMK_calibrate()
+{
+    // Time (ns) of a fixed chain of dependent integer operations.
+    // Any change of this time between samples is CPU frequency drift.
+    U64 best = (U64)-1;
+    int run;
+    for (run=0; run<3; run++)
+    {
+        U32 x = run + 1;
+        int i;
+        U64 start = BMK_GetNanoTime();
+        for (i=0; i<CALIBRATION_LOOPS; i++) x = x * KNUTH + 1;
+        calibrationSink = x;
+        start = BMK_GetNanoTime() - start;
+        if (start < best) best = start;
+    }
+    return (double)best;
+}
+
+static int BMK_compareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double BMK_median(double* sorted, int n)
+{
+    return (n & 1) ? sorted[n/2] : (sorted[n/2-1] + sorted[n/2]) / 2.;
+}
+
+static double BMK_tValue95(int degreesOfFreedom)
+{
+    // Two-sided 95% quantiles of Student's t distribution
+    static const double t95[30] = { 12.71, 4.30, 3.18, 2.78, 2.57, 2.45, 2.36, 2.31, 2.26, 2.23,
+                                     2.20, 2.18, 2.16, 2.14, 2.13, 2.12, 2.11, 2.10, 2.09, 2.09,
+                                     2.08, 2.07, 2.07, 2.06, 2.06, 2.06, 2.05, 2.05, 2.05, 2.04 };
+    if (degreesOfFreedom < 1) return t95[0];
+    if (degreesOfFreedom <= 30) return t95[degreesOfFreedom-1];
+    return 1.96;
+}
+
+struct sampleStatistics
+{
+    int    samples;
+    int    kept;
+    double mean;
+    double median;
+    double stddev;
+    double ci;          // half width of the 95% confidence interval, in % of the mean
+};
+
+static void BMK_computeStatistics(const double* samples, int n, struct sampleStatistics* st)
+{
+    // Rejects outliers with the median absolute deviation, then computes
+    // mean, standard deviation and confidence interval of the remaining samples.
+    double* sorted = (double*) malloc(n * sizeof(double));
+    double* deviation = (double*) malloc(n * sizeof(double));
+    double mad, sum = 0., sumSq = 0.;
+    int i;
+
+    memset(st, 0, sizeof(*st));
+    if ((sorted==NULL) || (deviation==NULL) || (n==0)) { free(sorted); free(deviation); return; }
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), BMK_compareDouble);
+    st->samples = n;
+    st->median = BMK_median(sorted, n);
+    for (i=0; i<n; i++) deviation[i] = (samples[i] > st->median) ? samples[i] - st->median : st->median - samples[i];
+    qsort(deviation, n, sizeof(double), BMK_compareDouble);
+    mad = BMK_median(deviation, n) * 1.4826;    // Consistent with stddev for normal data
+
+    for (i=0; i<n; i++)
+    {
+        double d = (samples[i] > st->median) ? samples[i] - st->median : st->median - samples[i];
+        if ((mad > 0.) && (d > STAT_OUTLIER_MADS * mad)) continue;
+        sum += samples[i];
+        sumSq += samples[i] * samples[i];
+        st->kept++;
+    }
+    st->mean = sum / st->kept;
+    if (st->kept > 1)
+    {
+        double variance = (sumSq - sum * sum / st->kept) / (st->kept - 1);
+        st->stddev = (variance > 0.) ? sqrt(variance) : 0.;
+        st->ci = BMK_tValue95(st->kept - 1) * st->stddev / sqrt((double)st->kept) / st->mean * 100.;
+    }
+    else st->ci = 100.;
+
+    free(sorted);
+    free(deviation);
+}
+
+static double BMK_sampleCodec(int decode, int algNb, struct chunkParameters* chunkP, int nbChunks, char* inFileName, struct sampleStatistics* st)
+{
+    // Samples one codec until the confidence interval reaches statTarget.
+    // Returns the frequency drift (in %) seen by the calibration loop.
+    char* name = decode ? decompressionNames[algNb] : compressionNames[algNb];
+    double* samples = (double*) malloc(STAT_MAX_SAMPLES * sizeof(double));
+    double calibrationStart, calibrationEnd;
+    int milliTime, n = 0;
+
+    if (samples==NULL) { DISPLAY("\nError: not enough memory!\n"); exit(12); }
+    calibrationStart = BMK_calibrate();
+    milliTime = BMK_GetMilliStart();
+    while (n < STAT_MAX_SAMPLES)
+    {
+        samples[n++] = BMK_timeChunks(decode, algNb, chunkP, nbChunks, inFileName, STAT_SAMPLE_MS);
+        if (n < STAT_MIN_SAMPLES) continue;
+        BMK_computeStatistics(samples, n, st);
+        DISPLAY("%-23.23s : %4i samples, +/-%.2f%%    \r", name, n, st->ci);
+        if ((st->ci <= statTarget) || (BMK_GetMilliSpan(milliTime) > STAT_MAX_MS)) break;
+    }
+    calibrationEnd = BMK_calibrate();
+
+    free(samples);
+    return (calibrationEnd - calibrationStart) / calibrationStart * 100.;
+}
+
+static void BMK_displayStatistics(char* name, struct sampleStatistics* st, double drift)
+{
+    DISPLAY("%-23.23s : %8.1f %8.1f %8.1f %7.2f%% %5i/%-5i %+6.2f%%%s\n", name, st->mean, st->median, st->stddev,
+            st->ci, st->kept, st->samples, drift,
+            (st->ci > statTarget) ? " (CI target missed)" : ((drift > STAT_DRIFT_WARNING) || (drift < -STAT_DRIFT_WARNING)) ? " (frequency drift)" : "");
+}
+
+static int BMK_statBench(char* inFileName, struct chunkParameters* chunkP, int nbChunks, char* orig_buff, size_t benchedSize, U32 crcOriginal)
+{
+    int algNb;
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i blocks of %i KB, calibration loop %.2f ms\n", inFileName, nbChunks, chunkSize>>10, BMK_calibrate() / 1000000.);
+    DISPLAY("%-23.23s : %8s %8s %8s %8s %11s %7s\n", "(MB/s)", "mean", "median", "stddev", "CI95", "kept", "drift");
+
+    for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+    {
+        struct sampleStatistics st;
+        double drift;
+        if (!BMK_compressorSelected(algNb)) continue;
+        drift = BMK_sampleCodec(0, algNb, chunkP, nbChunks, inFileName, &st);
+        BMK_displayStatistics(compressionNames[algNb], &st, drift);
+    }
+
+    BMK_prepareDecompression(chunkP, nbChunks);
+    if (decompressionTest) memset(orig_buff, 0, benchedSize);     // zeroing source area, for CRC checking
+
+    for (algNb=0; (algNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); algNb++)
+    {
+        struct sampleStatistics st;
+        double drift;
+        U32 crcDecoded;
+        if (!BMK_decompressorSelected(algNb)) continue;
+        drift = BMK_sampleCodec(1, algNb, chunkP, nbChunks, inFileName, &st);
+        BMK_displayStatistics(decompressionNames[algNb], &st, drift);
+
+        crcDecoded = XXH32(orig_buff, (int)benchedSize, 0);
+        if (crcOriginal!=crcDecoded)
+        {
+            DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOriginal, (unsigned)crcDecoded);
+            compareBufferToFile(orig_buff, benchedSize, inFileName, 0);
+        }
+    }
+
+    return 0;
+}
+
+
+//*********************************************************
+//  Working set sweep
+//*********************************************************
+static void BMK_fillFromBuffer(char* dst, size_t size, const char* src, size_t srcSize, U64 pos)
+{
+    // Copy size bytes of src starting at pos, wrapping around at the end of src
+    size_t filled = 0;
+    pos %= srcSize;
+    while (filled < size)
+    {
+        size_t n = srcSize - (size_t)pos;
+        if (n > size - filled) n = size - filled;
+        memcpy(dst + filled, src + pos, n);
+        filled += n; pos = 0;
+    }
+}
+
+static const char* BMK_cacheLevelName(size_t footprint)
+{
+    // Smallest cache level holding footprint, levels of unknown size skipped
+    static const char* levelNames[] = { "L1", "L2", "L3" };
+    int level, known = 0;
+    for (level=1; level<=3; level++)
+    {
+        size_t size = BMK_getCacheSize(level);
+        if (size == 0) continue;
+        if (footprint <= size) return levelNames[level-1];
+        known = 1;
+    }
+    return known ? "DRAM" : "unknown";
+}
+
+static int BMK_workingSetSweep(char* inFileName, char* orig_buff, size_t benchedSize)
+{
+    // Benchmarks every selected codec with a growing number of blocks, so that
+    // the footprint (source blocks + compressed blocks) walks from L1 out to DRAM.
+    // Each block has a compressed buffer per stream format (LZ4, LZJB, ZFS lz4).
+    int maxCompressedChunkSize = LZ4_compressBound(chunkSize);
+    size_t blockFootprint = (size_t)chunkSize + 3 * (size_t)maxCompressedChunkSize;
+    size_t maxFootprint = BMK_getLLCSize() * SWEEP_LLC_MULTIPLE;
+    int maxChunks = (int)(maxFootprint / blockFootprint) + 1;
+    struct chunkParameters* chunkP;
+    char* sweepBuffer = NULL;
+    char* reference;
+    int nbChunks, chunkNb, algNb;
+
+    // Tile the file contents over as many blocks as the largest working set needs
+    while (maxChunks > 0)
+    {
+        sweepBuffer = (char*) malloc((size_t)maxChunks * (blockFootprint + chunkSize));
+        if (sweepBuffer!=NULL) break;
+        maxChunks /= 2;
+    }
+    chunkP = (struct chunkParameters*) malloc(maxChunks * sizeof(struct chunkParameters));
+    if ((sweepBuffer==NULL) || (chunkP==NULL)) { DISPLAY("\nError: not enough memory!\n"); free(sweepBuffer); free(chunkP); return 12; }
+    if ((size_t)maxChunks * blockFootprint < maxFootprint)
+        DISPLAY("Not enough memory for a %i MB working set; sweeping up to %i MB only...\n", (int)(maxFootprint>>20), (int)(((size_t)maxChunks * blockFootprint)>>20));
+
+    reference = sweepBuffer + (size_t)maxChunks * blockFootprint;
+    for (chunkNb=0; chunkNb<maxChunks; chunkNb++)
+    {
+        char* block = sweepBuffer + (size_t)chunkNb * blockFootprint;
+        char* ref = reference + (size_t)chunkNb * chunkSize;
+        BMK_fillFromBuffer(ref, chunkSize, orig_buff, benchedSize, (size_t)chunkNb * chunkSize);
+        chunkP[chunkNb].id = chunkNb;
+        chunkP[chunkNb].origBuffer = block;
+        chunkP[chunkNb].origSize = chunkSize;
+        chunkP[chunkNb].compressedBuffer = block + chunkSize;
+        chunkP[chunkNb].compressedSize = 0;
+        chunkP[chunkNb].compressedLZJBBuffer = block + chunkSize + maxCompressedChunkSize;
+        chunkP[chunkNb].compressedLZJBSize = 0;
+        chunkP[chunkNb].compressedZFSLZ4Buffer = block + chunkSize + 2 * (size_t)maxCompressedChunkSize;
+        chunkP[chunkNb].compressedZFSLZ4Size = 0;
+        memcpy(chunkP[chunkNb].origBuffer, ref, chunkSize);
+    }
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY("# working set sweep : %s, blocks of %i KB, L1 %i KB, L2 %i KB, L3 %i KB\n", inFileName, chunkSize>>10,
+            (int)(BMK_getCacheSize(1)>>10), (int)(BMK_getCacheSize(2)>>10), (int)(BMK_getCacheSize(3)>>10));
+    DISPLAY("# footprint (KB) = blocks x (source block + 3 compressed block capacities), throughput in MB/s\n");
+    if ((BMK_getCacheSize(1) != 0) && (blockFootprint > BMK_getCacheSize(1)))
+        DISPLAY("# warning : one block already takes %i KB, the sweep starts in %s; use a smaller -B (e.g. -B4K) to measure L1%s\n",
+                (int)(blockFootprint>>10), BMK_cacheLevelName(blockFootprint),
+                ((BMK_getCacheSize(2) != 0) && (blockFootprint > BMK_getCacheSize(2))) ? " and L2" : "");
+    DISPLAY("# %9s %6s %5s", "footprint", "blocks", "level");
+    for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+        if (BMK_compressorSelected(algNb)) DISPLAY(" %21.21s", compressionNames[algNb]);
+    for (algNb=0; (algNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); algNb++)
+        if (BMK_decompressorSelected(algNb)) DISPLAY(" %21.21s", decompressionNames[algNb]);
+    DISPLAY("\n");
+
+    for (nbChunks=1; nbChunks<=maxChunks; nbChunks*=2)
+    {
+        size_t footprint = (size_t)nbChunks * blockFootprint;
+        double speed[NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS];
+        int nbSpeeds = 0, i;
+
+        for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+            if (BMK_compressorSelected(algNb)) speed[nbSpeeds++] = BMK_benchChunks(0, algNb, chunkP, nbChunks, NULL);
+
+        BMK_prepareDecompression(chunkP, nbChunks);
+        for (algNb=0; (algNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); algNb++)
+        {
+            if (!BMK_decompressorSelected(algNb)) continue;
+            speed[nbSpeeds++] = BMK_benchChunks(1, algNb, chunkP, nbChunks, NULL);
+            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+                if (memcmp(chunkP[chunkNb].origBuffer, reference + (size_t)chunkNb * chunkSize, chunkSize))
+                    DISPLAY("\n!!! WARNING !!! %s : block %i decoded incorrectly\n", decompressionNames[algNb], chunkNb);
+        }
+
+        DISPLAY("  %9i %6i %5s", (int)(footprint>>10), nbChunks, BMK_cacheLevelName(footprint));
+        for (i=0; i<nbSpeeds; i++) DISPLAY(" %21.1f", speed[i]);
+        DISPLAY("\n");
+    }
+
+    free(sweepBuffer);
+    free(chunkP);
+    return 0;
+}
+
+
+//*********************************************************
+//  I/O trace replay
+//*********************************************************
+// Trace files hold one operation per line, '#' starts a comment :
+//    <op> <file offset> <length> <codec>
+// op    : c or w = compress (write), d or r = decompress (read)
+// codec : compressor (for c/w) or decompressor (for d/r), by -C/-D number or by name
+#define TRACE_NB_CLASSES 32
+
+struct traceOperation
+{
+    int decode;
+    int algNb;
+    U64 offset;
+    int length;
+    struct chunkParameters chunk;
+    char* reference;
+};
+
+static int BMK_findCodec(const char* name, char** names, int nbNames)
+{
+    int algNb;
+    if ((name[0] >= '0') && (name[0] <= '9') && (name[1]==0) && (name[0]-'0' < nbNames) && names[name[0]-'0']) return name[0]-'0';
+    for (algNb=0; algNb<nbNames; algNb++)
+    {
+        const char* a = name;
+        const char* b = names[algNb];
+        if (b == NULL) continue;
+        while ((*a) && (tolower((unsigned char)*a) == tolower((unsigned char)*b))) a++, b++;
+        if ((*a==0) && (*b==0)) return algNb;
+    }
+    return -1;
+}
+
+static int BMK_sizeClass(int length)
+{
+    int sizeClass = 0;
+    while ((sizeClass < TRACE_NB_CLASSES-1) && ((1 << sizeClass) < length)) sizeClass++;
+    return sizeClass;
+}
+
+static int BMK_loadTrace(struct traceOperation** opsPtr)
+{
+    FILE* traceFile = fopen(traceFileName, "r");
+    struct traceOperation* ops = NULL;
+    char line[256];
+    int nbOps = 0, maxOps = 0, lineNb = 0;
+
+    if (traceFile==NULL) { DISPLAY("Problem opening trace %s\n", traceFileName); return -1; }
+    while (fgets(line, sizeof line, traceFile))
+    {
+        char op, codec[64];
+        long long unsigned offset;
+        int length, fields;
+
+        lineNb++;
+        fields = sscanf(line, " %c %llu %i %63[^\r\n#]", &op, &offset, &length, codec);
+        if ((fields <= 0) || (op=='#')) continue;
+        if (fields == 4) { char* end = codec + strlen(codec); while ((end > codec) && isspace((unsigned char)end[-1])) *--end = 0; }
+        if (nbOps == maxOps)
+        {
+            maxOps = maxOps ? maxOps*2 : 256;
+            ops = (struct traceOperation*) realloc(ops, maxOps * sizeof(struct traceOperation));
+            if (ops==NULL) { DISPLAY("\nError: not enough memory!\n"); fclose(traceFile); return -1; }
+        }
+        memset(&ops[nbOps], 0, sizeof(struct traceOperation));
+        ops[nbOps].decode = ((op=='d') || (op=='r'));
+        ops[nbOps].offset = offset;
+        ops[nbOps].length = length;
+        if (fields != 4) ops[nbOps].algNb = -1;
+        else if (ops[nbOps].decode) ops[nbOps].algNb = BMK_findCodec(codec, decompressionNames, NB_DECOMPRESSION_ALGORITHMS);
+        else ops[nbOps].algNb = BMK_findCodec(codec, compressionNames, NB_COMPRESSION_ALGORITHMS);
+        if (((!ops[nbOps].decode) && (op!='c') && (op!='w')) || (ops[nbOps].algNb < 0)
+            || (length <= 0) || (length > LZ4_MAX_INPUT_SIZE))
+        {
+            DISPLAY("Error: bad trace entry at %s:%i : %s", traceFileName, lineNb, line);
+            free(ops); fclose(traceFile);
+            return -1;
+        }
+        nbOps++;
+    }
+    fclose(traceFile);
+
+    *opsPtr = ops;
+    return nbOps;
+}
+
+static int BMK_traceReplay(char* inFileName, char* orig_buff, size_t benchedSize)
+{
+    // Replays the trace against the loaded file, timing every operation.
+    // Operations are run in trace order; the fastest full replay is reported.
+    struct traceOperation* ops = NULL;
+    double classBytes[2][TRACE_NB_CLASSES], classNanos[2][TRACE_NB_CLASSES];
+    double bestClassBytes[2][TRACE_NB_CLASSES] = {{0}}, bestClassNanos[2][TRACE_NB_CLASSES] = {{0}};
+    int classOps[2][TRACE_NB_CLASSES] = {{0}};
+    double cBytes[NB_COMPRESSION_ALGORITHMS], cNanos[NB_COMPRESSION_ALGORITHMS];
+    double dBytes[NB_DECOMPRESSION_ALGORITHMS], dNanos[NB_DECOMPRESSION_ALGORITHMS];
+    double bestCBytes[NB_COMPRESSION_ALGORITHMS] = {0}, bestCNanos[NB_COMPRESSION_ALGORITHMS] = {0};
+    double bestDBytes[NB_DECOMPRESSION_ALGORITHMS] = {0}, bestDNanos[NB_DECOMPRESSION_ALGORITHMS] = {0};
+    int cOps[NB_COMPRESSION_ALGORITHMS] = {0}, dOps[NB_DECOMPRESSION_ALGORITHMS] = {0};
+    double bestSpeed = 0.;
+    U64 replayBytes = 0;
+    int savedChunkSize = chunkSize;
+    int nbOps, opNb, loopNb, sizeClass, decode, algNb, nbWrapped = 0, result = 0;
+
+    nbOps = BMK_loadTrace(&ops);
+    if (nbOps < 0) return 14;
+    if (nbOps == 0) { DISPLAY("Trace %s is empty\n", traceFileName); free(ops); return 14; }
+
+    // Private buffers for every operation, so that reads can be verified
+    for (opNb=0; opNb<nbOps; opNb++)
+    {
+        struct traceOperation* op = &ops[opNb];
+        int bound = LZ4_compressBound(op->length);
+        char* buffer = (char*) malloc((size_t)op->length*2 + (size_t)bound*3);
+        if (buffer==NULL) { DISPLAY("\nError: not enough memory!\n"); nbOps = opNb; result = 12; goto _cleanup; }
+        op->reference = buffer;
+        op->chunk.id = opNb;
+        op->chunk.origBuffer = buffer + op->length;
+        op->chunk.origSize = op->length;
+        op->chunk.compressedBuffer = buffer + (size_t)op->length*2;
+        op->chunk.compressedLZJBBuffer = op->chunk.compressedBuffer + bound;
+        op->chunk.compressedZFSLZ4Buffer = op->chunk.compressedLZJBBuffer + bound;
+        if (op->offset + op->length > benchedSize) nbWrapped++;
+        BMK_fillFromBuffer(op->reference, op->length, orig_buff, benchedSize, op->offset);
+        memcpy(op->chunk.origBuffer, op->reference, op->length);
+        if (op->decode)
+        {
+            // The ZFS wrappers size their output buffer from chunkSize
+            chunkSize = op->length;
+            BMK_prepareDecompression(&op->chunk, 1);
+        }
+        classOps[op->decode][BMK_sizeClass(op->length)]++;
+        if (op->decode) dOps[op->algNb]++; else cOps[op->algNb]++;
+        replayBytes += op->length;
+    }
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s replayed on %s : %i operations, %llu bytes\n", traceFileName, inFileName, nbOps, (long long unsigned)replayBytes);
+    if (nbWrapped)
+        DISPLAY("WARNING: %i operation(s) reach past the %llu bytes loaded, their data wraps around to the start\n", nbWrapped, (long long unsigned)benchedSize);
+
+    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+    {
+        U64 nanos = 0, bytes = 0;
+        int milliTime;
+        double speed;
+
+        DISPLAY("%1i-%-21.21s\r", loopNb, "trace replay");
+        memset(classBytes, 0, sizeof(classBytes));
+        memset(classNanos, 0, sizeof(classNanos));
+        memset(cBytes, 0, sizeof(cBytes)); memset(cNanos, 0, sizeof(cNanos));
+        memset(dBytes, 0, sizeof(dBytes)); memset(dNanos, 0, sizeof(dNanos));
+
+        milliTime = BMK_GetMilliStart();
+        do
+        {
+            for (opNb=0; opNb<nbOps; opNb++)
+            {
+                struct traceOperation* op = &ops[opNb];
+                compressor_t compressionFunction = NULL;
+                initializer_t initFunction = NULL;
+                decompressor_t decompressionFunction = NULL;
+                U64 start, spent;
+                int result;
+
+                if (op->decode) BMK_selectDecompressor(op->algNb, &decompressionFunction);
+                else BMK_selectCompressor(op->algNb, &compressionFunction, &initFunction);
+                chunkSize = op->length;
+                if (initFunction!=NULL) ctx = initFunction(op->chunk.origBuffer);
+
+                start = BMK_GetNanoTime();
+                result = BMK_runChunk(compressionFunction, op->algNb, decompressionFunction, &op->chunk);
+                spent = BMK_GetNanoTime() - start;
+
+                if (initFunction!=NULL) free(ctx);
+                if ((!op->decode) && (result==0)) DISPLAY("ERROR ! %s() = 0 !! \n", compressionNames[op->algNb]), exit(1);
+                if ((op->decode) && (result!=op->length))
+                {
+                    DISPLAY("ERROR @ trace operation %i ! %s() == %i != %i !! \n", opNb, decompressionNames[op->algNb], result, op->length);
+                    exit(1);
+                }
+                sizeClass = BMK_sizeClass(op->length);
+                classBytes[op->decode][sizeClass] += op->length;
+                classNanos[op->decode][sizeClass] += (double)spent;
+                if (op->decode) dBytes[op->algNb] += op->length, dNanos[op->algNb] += (double)spent;
+                else cBytes[op->algNb] += op->length, cNanos[op->algNb] += (double)spent;
+                bytes += op->length;
+                nanos += spent;
+            }
+        } while (BMK_GetMilliSpan(milliTime) < TIMELOOP);
+
+        speed = (double)bytes * 1000. / (double)nanos;
+        if (speed > bestSpeed)
+        {
+            bestSpeed = speed;
+            memcpy(bestClassBytes, classBytes, sizeof(classBytes));
+            memcpy(bestClassNanos, classNanos, sizeof(classNanos));
+            memcpy(bestCBytes, cBytes, sizeof(cBytes)); memcpy(bestCNanos, cNanos, sizeof(cNanos));
+            memcpy(bestDBytes, dBytes, sizeof(dBytes)); memcpy(bestDNanos, dNanos, sizeof(dNanos));
+        }
+    }
+
+    for (opNb=0; opNb<nbOps; opNb++)
+        if ((ops[opNb].decode) && (memcmp(ops[opNb].chunk.origBuffer, ops[opNb].reference, ops[opNb].length)))
+            DISPLAY("\n!!! WARNING !!! trace operation %i : %s decoded incorrectly\n", opNb, decompressionNames[ops[opNb].algNb]);
+
+    DISPLAY("%-12s : %8s %12s %8s %12s\n", "size class", "writes", "compress", "reads", "decompress");
+    for (sizeClass=0; sizeClass<TRACE_NB_CLASSES; sizeClass++)
+    {
+        char label[16];
+        if ((classOps[0][sizeClass]==0) && (classOps[1][sizeClass]==0)) continue;
+        if (sizeClass >= 20) sprintf(label, "<= %i MB", 1 << (sizeClass-20));
+        else if (sizeClass >= 10) sprintf(label, "<= %i KB", 1 << (sizeClass-10));
+        else sprintf(label, "<= %i B", 1 << sizeClass);
+        DISPLAY("%-12s :", label);
+        for (decode=0; decode<2; decode++)
+        {
+            if (classOps[decode][sizeClass]) DISPLAY(" %8i %7.1f MB/s", classOps[decode][sizeClass], bestClassBytes[decode][sizeClass] * 1000. / bestClassNanos[decode][sizeClass]);
+            else DISPLAY(" %8i %12s", 0, "-");
+        }
+        DISPLAY("\n");
+    }
+    DISPLAY("%-12s :", "all");
+    for (decode=0; decode<2; decode++)
+    {
+        double bytes = 0, nanos = 0;
+        int count = 0;
+        for (sizeClass=0; sizeClass<TRACE_NB_CLASSES; sizeClass++)
+            bytes += bestClassBytes[decode][sizeClass], nanos += bestClassNanos[decode][sizeClass], count += classOps[decode][sizeClass];
+        if (count) DISPLAY(" %8i %7.1f MB/s", count, bytes * 1000. / nanos);
+        else DISPLAY(" %8i %12s", 0, "-");
+    }
+    DISPLAY("\n%-12s : %7.1f MB/s\n", "aggregate", bestSpeed);
+
+    // Per codec named in the trace, from the same fastest replay
+    DISPLAY("%-23.23s : %8s %12s\n", "codec", "ops", "speed");
+    for (algNb=0; algNb<NB_COMPRESSION_ALGORITHMS; algNb++)
+        if (cOps[algNb]) DISPLAY("%-23.23s : %8i %7.1f MB/s\n", compressionNames[algNb], cOps[algNb], bestCBytes[algNb] * 1000. / bestCNanos[algNb]);
+    for (algNb=0; algNb<NB_DECOMPRESSION_ALGORITHMS; algNb++)
+        if (dOps[algNb]) DISPLAY("%-23.23s : %8i %7.1f MB/s\n", decompressionNames[algNb], dOps[algNb], bestDBytes[algNb] * 1000. / bestDNanos[algNb]);
+
+_cleanup:
+    chunkSize = savedChunkSize;
+    for (opNb=0; opNb<nbOps; opNb++) free(ops[opNb].reference);
+    free(ops);
+    return result;
+}
+
+
+//*********************************************************
+//  ZFS compression decision
+//*********************************************************
+// zio_write_compress() keeps a compressed block only if it saves at least 1/8th
+// of the logical size; otherwise the block is written uncompressed, and the
+// time spent compressing it is lost. Allocations are rounded up to the sector size.
+#define ZFS_MIN_SAVING_SHIFT 3      // 12.5%
+#define ZFS_DEFAULT_ASHIFT   12
+
+static U64 BMK_roundToSector(U64 size)
+{
+    U64 sector = (U64)1 << zfsAshift;
+    return (size + sector - 1) & ~(sector - 1);
+}
+
+static int BMK_zfsBench(char* inFileName, struct chunkParameters* chunkP, int nbChunks)
+{
+    U64* blockTime = (U64*) malloc(nbChunks * sizeof(U64));
+    U64 logicalSize = 0, allocatedSize = 0;
+    int chunkNb, algNb, nbUnlimited = 0;
+
+    if (blockTime==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+    for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+    {
+        logicalSize += chunkP[chunkNb].origSize;
+        allocatedSize += BMK_roundToSector(chunkP[chunkNb].origSize);
+    }
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i blocks of %i KB, ashift %i (%i byte sectors), blocks kept compressed when they save >= %.1f%%\n",
+            inFileName, nbChunks, chunkSize>>10, zfsAshift, 1<<zfsAshift, 100. / (1<<ZFS_MIN_SAVING_SHIFT));
+    DISPLAY("%-21.21s : %10llu logical, %10llu on disk uncompressed\n", "uncompressed", (long long unsigned int)logicalSize, (long long unsigned int)allocatedSize);
+
+    for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+    {
+        char* cName = compressionNames[algNb];
+        compressor_t compressionFunction;
+        limitedCompressor_t limitedFunction = BMK_limitedCompressor(algNb);
+        initializer_t initFunction;
+        U64 rawSize = 0, onDisk = 0, totalTime = 0, wastedTime = 0;
+        int limited = (limitedFunction != NULL);
+        int nbKept = 0, loopNb = 0;
+        int milliTime;
+
+        if (!BMK_compressorSelected(algNb)) continue;
+        if (BMK_selectCompressor(algNb, &compressionFunction, &initFunction)) { free(blockTime); return 1; }
+
+        // Raw size, with room for the whole compressed block
+        if (initFunction!=NULL) ctx = initFunction(chunkP[0].origBuffer);
+        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+            rawSize += compressionFunction(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize);
+        if (initFunction!=NULL) free(ctx);
+
+        // Each block keeps its fastest time over at least nbIterations passes and TIMELOOP ms.
+        // ZFS compressors get zio_compress_data()'s d_len, and give up on a block as ZFS does
+        for (chunkNb=0; chunkNb<nbChunks; chunkNb++) blockTime[chunkNb] = (U64)-1;
+        milliTime = BMK_GetMilliStart();
+        while ((loopNb < nbIterations) || (BMK_GetMilliSpan(milliTime) < TIMELOOP))
+        {
+            DISPLAY("%1i-%-19.19s :\r", loopNb+1, cName);
+            if (initFunction!=NULL) ctx = initFunction(chunkP[0].origBuffer);
+            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+            {
+                struct chunkParameters* chunk = &chunkP[chunkNb];
+                int dLen = chunk->origSize - (chunk->origSize >> ZFS_MIN_SAVING_SHIFT);
+                U64 start = BMK_GetNanoTime();
+                if (limited) chunk->compressedSize = limitedFunction(chunk->origBuffer, chunk->compressedBuffer, chunk->origSize, dLen);
+                else chunk->compressedSize = compressionFunction(chunk->origBuffer, chunk->compressedBuffer, chunk->origSize);
+                start = BMK_GetNanoTime() - start;
+                if (chunkP[chunkNb].compressedSize==0) DISPLAY("ERROR ! %s() = 0 !! \n", cName), exit(1);
+                if (start < blockTime[chunkNb]) blockTime[chunkNb] = start;
+            }
+            if (initFunction!=NULL) free(ctx);
+            loopNb++;
+        }
+
+        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+        {
+            int lsize = chunkP[chunkNb].origSize;
+            int csize = chunkP[chunkNb].compressedSize;
+            int kept = (csize <= lsize - (lsize >> ZFS_MIN_SAVING_SHIFT)) && (BMK_roundToSector(csize) < BMK_roundToSector(lsize));
+            totalTime += blockTime[chunkNb];
+            if (kept) { nbKept++; onDisk += BMK_roundToSector(csize); }
+            else { wastedTime += blockTime[chunkNb]; onDisk += BMK_roundToSector(lsize); }
+        }
+
+        DISPLAY("%-21.21s : raw %6.2f%%, on disk %10llu (%6.2f%%), kept %5.1f%%, CPU %9.3f ms, wasted %9.3f ms (%4.1f%%)%s\n", cName,
+                (double)rawSize / logicalSize * 100., (long long unsigned int)onDisk, (double)onDisk / allocatedSize * 100.,
+                (double)nbKept / nbChunks * 100., (double)totalTime / 1000000., (double)wastedTime / 1000000.,
+                totalTime ? (double)wastedTime / totalTime * 100. : 0., limited ? "" : " *");
+        if (!limited) nbUnlimited++;
+    }
+    if (nbUnlimited) DISPLAY("* : not a ZFS compressor, no output limit : rejected blocks are compressed in full, wasted time is an upper bound\n");
+
+    free(blockTime);
+    return 0;
+}
+
+
+//*********************************************************
+//  Concurrent workers
+//*********************************************************
+#if !defined(BMK_NO_THREADS)
+struct workerParameters
+{
+    pthread_t thread;
+    int index;        // its cpu under -P : the index-th of the pinned set
+    int decode;
+    int algNb;
+    int nbChunks;
+    char* orig_buff;
+    size_t benchedSize;
+    struct chunkParameters* chunkP;
+    char* buffer;
+    U64 bytes;        // decoded size of all blocks processed
+    U64 touched;      // bytes read and written by the codec
+    U64 nanos;
+    int failed;
+};
+
+static pthread_mutex_t workerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  workerCond = PTHREAD_COND_INITIALIZER;
+static int workersReady = 0;
+static int workersGo = 0;
+
+static void BMK_pinThread(int cpuOffset)
+{
+    // Under -P, BMK_isolate() pins the process to a set of cpus starting at
+    // pinCPU; each thread then takes its own cpu of that set. A cpu missing
+    // from the set was reported there, the thread then keeps the whole set.
+#if defined(__linux__)
+    cpu_set_t set;
+    if (pinCPU < 0) return;
+    CPU_ZERO(&set);
+    CPU_SET(pinCPU + cpuOffset, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpuOffset;
+#endif
+}
+
+static void* BMK_worker(void* arg)
+{
+    struct workerParameters* w = (struct workerParameters*) arg;
+    compressor_t compressionFunction = NULL;
+    initializer_t initFunction = NULL;
+    decompressor_t decompressionFunction = NULL;
+    int chunkNb, milliTime;
+    U64 start;
+
+    BMK_pinThread(w->index);
+    if (w->decode) BMK_selectDecompressor(w->algNb, &decompressionFunction);
+    else BMK_selectCompressor(w->algNb, &compressionFunction, &initFunction);
+    if (w->decode)
+    {
+        // Blocks from the original, in case a previous decoder left them wrong,
+        // then cleared so that the final check sees only what this decoder wrote
+        memcpy(w->buffer, w->orig_buff, w->benchedSize);
+        BMK_prepareDecompression(w->chunkP, w->nbChunks);
+        memset(w->buffer, 0, w->benchedSize);
+    }
+
+    // Wait for every worker to be ready, so that all of them run together
+    pthread_mutex_lock(&workerMutex);
+    workersReady++;
+    pthread_cond_broadcast(&workerCond);
+    while (!workersGo) pthread_cond_wait(&workerCond, &workerMutex);
+    pthread_mutex_unlock(&workerMutex);
+
+    milliTime = BMK_GetMilliStart();
+    start = BMK_GetNanoTime();
+    while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+    {
+        if (initFunction!=NULL)
+        {
+            pthread_mutex_lock(&workerMutex);
+            ctx = initFunction(w->chunkP[0].origBuffer);
+            pthread_mutex_unlock(&workerMutex);
+        }
+        for (chunkNb=0; chunkNb<w->nbChunks; chunkNb++)
+        {
+            struct chunkParameters* chunk = &w->chunkP[chunkNb];
+            int result = BMK_runChunk(compressionFunction, w->algNb, decompressionFunction, chunk);
+            if ((!w->decode) && (result==0)) { w->failed = 1; break; }
+            if ((w->decode) && (result!=chunk->origSize)) { w->failed = 1; break; }
+            w->bytes += chunk->origSize;
+            if (!w->decode)
+                w->touched += (U64)chunk->origSize + chunk->compressedSize;
+            else
+            {
+                int* size;
+                BMK_referenceStream(chunk, decompressionFormats[w->algNb], &size);
+                w->touched += (U64)chunk->origSize + *size;
+            }
+        }
+        if (initFunction!=NULL) free(ctx);
+        if (w->failed) break;
+    }
+    w->nanos = BMK_GetNanoTime() - start;
+
+    if ((w->decode) && (!w->failed) && (memcmp(w->buffer, w->orig_buff, w->benchedSize))) w->failed = 2;
+    return NULL;
+}
+
+static int BMK_runWorkers(struct workerParameters* workers, int count, int decode, int algNb, double* speed, double* bandwidth)
+{
+    // Runs count workers together, returns 1 when any of them failed
+    int i, failed = 0;
+
+    *speed = 0.; *bandwidth = 0.;
+    workersReady = 0; workersGo = 0;
+    for (i=0; i<count; i++)
+    {
+        workers[i].index = i;
+        workers[i].decode = decode;
+        workers[i].algNb = algNb;
+        workers[i].bytes = workers[i].touched = workers[i].nanos = 0;
+        workers[i].failed = 0;
+        if (pthread_create(&workers[i].thread, NULL, BMK_worker, &workers[i]))
+        {
+            DISPLAY("\nError: can not create worker thread %i\n", i);
+            exit(1);
+        }
+    }
+
+    pthread_mutex_lock(&workerMutex);
+    while (workersReady < count) pthread_cond_wait(&workerCond, &workerMutex);
+    workersGo = 1;
+    pthread_cond_broadcast(&workerCond);
+    pthread_mutex_unlock(&workerMutex);
+
+    for (i=0; i<count; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        if (workers[i].failed) failed = workers[i].failed;
+        *speed += (double)workers[i].bytes * 1000. / (double)workers[i].nanos;
+        *bandwidth += (double)workers[i].touched * 1000. / (double)workers[i].nanos;
+    }
+    return failed;
+}
+
+static int BMK_threadBench(char* inFileName, char* orig_buff, size_t benchedSize, int nbChunks)
+{
+    // Scaling test : 1, 2, 4 ... nbWorkers workers run the same codec at the
+    // same time, each one on a private copy of the file.
+    struct workerParameters* workers = (struct workerParameters*) calloc(nbWorkers, sizeof(struct workerParameters));
+    int maxCompressedChunkSize = LZ4_compressBound(chunkSize);
+    size_t workerSize = benchedSize + 3 * (size_t)nbChunks * maxCompressedChunkSize;
+    long nbCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int i, count, algNb, decode, result = 0;
+
+    if (workers==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+    for (i=0; i<nbWorkers; i++)
+    {
+        workers[i].buffer = (char*) malloc(workerSize);
+        workers[i].chunkP = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+        if ((workers[i].buffer==NULL) || (workers[i].chunkP==NULL)) { DISPLAY("\nError: not enough memory for %i workers!\n", nbWorkers); result = 12; goto _cleanup; }
+        memcpy(workers[i].buffer, orig_buff, benchedSize);
+        workers[i].orig_buff = orig_buff;
+        workers[i].benchedSize = benchedSize;
+        workers[i].nbChunks = nbChunks;
+        BMK_initChunks(workers[i].chunkP, nbChunks, workers[i].buffer, benchedSize,
+                       workers[i].buffer + benchedSize, workers[i].buffer + benchedSize + (size_t)nbChunks * maxCompressedChunkSize,
+                       workers[i].buffer + benchedSize + 2 * (size_t)nbChunks * maxCompressedChunkSize);
+    }
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i workers, %i MB each, %li cpus online\n", inFileName, nbWorkers, (int)(workerSize>>20), nbCpus);
+    if (nbCpus < nbWorkers) DISPLAY("WARNING: more workers than online cpus, workers will share cores\n");
+    DISPLAY("%-23.23s : %7s %12s %12s %14s\n", "", "workers", "total MB/s", "MB/s/worker", "memory MB/s");
+
+    for (decode=0; decode<2; decode++)
+    for (algNb=0; algNb < (decode ? NB_DECOMPRESSION_ALGORITHMS : NB_COMPRESSION_ALGORITHMS); algNb++)
+    {
+        char* name = decode ? decompressionNames[algNb] : compressionNames[algNb];
+        if (decode ? (!decompressionTest || !BMK_decompressorSelected(algNb)) : (!compressionTest || !BMK_compressorSelected(algNb))) continue;
+
+        for (count=1; ; count = (count*2 > nbWorkers) ? nbWorkers : count*2)
+        {
+            double speed, bandwidth, bestSpeed = 0., bestBandwidth = 0.;
+            int loopNb;
+            for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+            {
+                DISPLAY("%1i-%-21.21s : %7i\r", loopNb, name, count);
+                if (BMK_runWorkers(workers, count, decode, algNb, &speed, &bandwidth))
+                {
+                    DISPLAY("ERROR ! %s() failed in a worker of %i on %s !! \n", name, count, inFileName);
+                    exit(1);
+                }
+                if (speed > bestSpeed) { bestSpeed = speed; bestBandwidth = bandwidth; }
+            }
+            DISPLAY("%-23.23s : %7i %12.1f %12.1f %14.1f\n", name, count, bestSpeed, bestSpeed / count, bestBandwidth);
+            if (count == nbWorkers) break;
+        }
+    }
+
+_cleanup:
+    for (i=0; i<nbWorkers; i++) { free(workers[i].buffer); free(workers[i].chunkP); }
+    free(workers);
+    return result;
+}
+
+//*********************************************************
+//  Read latency under write load
+//*********************************************************
+// Readers decompress and writers compress the same file at the same time :
+// readers decode one shared set of compressed blocks into private outputs,
+// writers compress the shared blocks into private buffers. Every block a
+// reader decodes is timed; writers run until the readers are done. Each
+// decompressor is measured alone, then under each compressor.
+#define MIXED_MAX_SAMPLES   (1<<20)     // per reader, later blocks are decoded but not recorded
+
+struct mixedThread
+{
+    pthread_t thread;
+    int decode;
+    int algNb;
+    int nbChunks;
+    int firstChunk;
+    struct chunkParameters* chunkP;
+    U64 bytes;
+    U64 nanos;
+    double* latencies;   // ns per block, readers only
+    int nbLatencies;
+    int failed;
+};
+
+static volatile int mixedStop = 0;
+
+static void* BMK_mixedThread(void* arg)
+{
+    struct mixedThread* t = (struct mixedThread*) arg;
+    compressor_t compressionFunction = NULL;
+    initializer_t initFunction = NULL;
+    decompressor_t decompressionFunction = NULL;
+    int n, milliTime;
+    U64 start;
+
+    if (t->decode) BMK_selectDecompressor(t->algNb, &decompressionFunction);
+    else BMK_selectCompressor(t->algNb, &compressionFunction, &initFunction);
+
+    pthread_mutex_lock(&workerMutex);
+    workersReady++;
+    pthread_cond_broadcast(&workerCond);
+    while (!workersGo) pthread_cond_wait(&workerCond, &workerMutex);
+    pthread_mutex_unlock(&workerMutex);
+
+    milliTime = BMK_GetMilliStart();
+    start = BMK_GetNanoTime();
+    while (t->decode ? (BMK_GetMilliSpan(milliTime) < TIMELOOP) : !mixedStop)
+    {
+        if (initFunction!=NULL)
+        {
+            pthread_mutex_lock(&workerMutex);
+            ctx = initFunction(t->chunkP[0].origBuffer);
+            pthread_mutex_unlock(&workerMutex);
+        }
+        // Readers start at different blocks, so they do not decode in lock step
+        for (n=0; (n<t->nbChunks) && (t->decode || !mixedStop); n++)
+        {
+            struct chunkParameters* chunk = &t->chunkP[(t->firstChunk + n) % t->nbChunks];
+            U64 opStart = BMK_GetNanoTime();
+            int result = BMK_runChunk(compressionFunction, t->algNb, decompressionFunction, chunk);
+            if (t->decode && (t->nbLatencies < MIXED_MAX_SAMPLES)) t->latencies[t->nbLatencies++] = (double)(BMK_GetNanoTime() - opStart);
+            if ((!t->decode) && (result==0)) { t->failed = 1; break; }
+            if ((t->decode) && (result!=chunk->origSize)) { t->failed = 1; break; }
+            t->bytes += chunk->origSize;
+        }
+        if (initFunction!=NULL) free(ctx);
+        if (t->failed) break;
+    }
+    t->nanos = BMK_GetNanoTime() - start;
+    return NULL;
+}
+
+static int BMK_runMixed(struct mixedThread* threads, int readers, int writers, int dAlgNb, int cAlgNb, double* readSpeed, double* writeSpeed)
+{
+    // Runs the readers with decompressor dAlgNb, and the writers with compressor
+    // cAlgNb until the readers are done; returns 1 when any of them failed
+    int i, count = readers + writers, failed = 0;
+
+    *readSpeed = 0.; *writeSpeed = 0.;
+    workersReady = 0; workersGo = 0; mixedStop = 0;
+    for (i=0; i<count; i++)
+    {
+        struct mixedThread* t = &threads[i];
+        t->decode = (i < readers);
+        t->algNb = t->decode ? dAlgNb : cAlgNb;
+        t->bytes = t->nanos = 0;
+        t->nbLatencies = 0;
+        t->failed = 0;
+        if (pthread_create(&t->thread, NULL, BMK_mixedThread, t))
+        {
+            DISPLAY("\nError: can not create thread %i\n", i);
+            exit(1);
+        }
+    }
+
+    pthread_mutex_lock(&workerMutex);
+    while (workersReady < count) pthread_cond_wait(&workerCond, &workerMutex);
+    workersGo = 1;
+    pthread_cond_broadcast(&workerCond);
+    pthread_mutex_unlock(&workerMutex);
+
+    for (i=0; i<count; i++)
+    {
+        if (i == readers) mixedStop = 1;
+        pthread_join(threads[i].thread, NULL);
+        if (threads[i].failed) failed = 1;
+        if (threads[i].nanos == 0) continue;
+        if (i < readers) *readSpeed += (double)threads[i].bytes * 1000. / (double)threads[i].nanos;
+        else *writeSpeed += (double)threads[i].bytes * 1000. / (double)threads[i].nanos;
+    }
+    return failed;
+}
+
+static int BMK_mixedBench(char* inFileName, char* orig_buff, size_t benchedSize, int nbChunks)
+{
+    int count = nbReaders + nbWriters;
+    struct mixedThread* threads = (struct mixedThread*) calloc(count, sizeof(struct mixedThread));
+    int maxCompressedChunkSize = LZ4_compressBound(chunkSize);
+    size_t compressedSize = (size_t)nbChunks * maxCompressedChunkSize;
+    long nbCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    struct chunkParameters* shared = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+    char* sharedBuffer = (char*) malloc(benchedSize + 3*compressedSize);
+    double* latencies = (double*) malloc((size_t)nbReaders * MIXED_MAX_SAMPLES * sizeof(double));
+    int i, n, dAlgNb, cAlgNb, result = 0;
+
+    if ((threads==NULL) || (shared==NULL) || (sharedBuffer==NULL) || (latencies==NULL)) { DISPLAY("\nError: not enough memory!\n"); result = 12; goto _cleanup; }
+
+    // Shared blocks and their compressed forms, in every format
+    memcpy(sharedBuffer, orig_buff, benchedSize);
+    BMK_initChunks(shared, nbChunks, sharedBuffer, benchedSize, sharedBuffer + benchedSize, sharedBuffer + benchedSize + compressedSize, sharedBuffer + benchedSize + 2*compressedSize);
+    BMK_prepareDecompression(shared, nbChunks);
+
+    for (i=0; i<count; i++)
+    {
+        struct mixedThread* t = &threads[i];
+        // Readers write decoded blocks, writers compressed blocks, to a private buffer
+        char* buffer = (char*) malloc((i < nbReaders) ? benchedSize : compressedSize);
+        t->chunkP = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+        if ((buffer==NULL) || (t->chunkP==NULL)) { free(buffer); free(t->chunkP); t->chunkP = NULL; DISPLAY("\nError: not enough memory for %i threads!\n", count); result = 12; goto _cleanup; }
+        memcpy(t->chunkP, shared, nbChunks * sizeof(struct chunkParameters));
+        for (n=0; n<nbChunks; n++)
+        {
+            if (i < nbReaders) t->chunkP[n].origBuffer = buffer + (size_t)n * chunkSize;
+            else t->chunkP[n].compressedBuffer = buffer + (size_t)n * maxCompressedChunkSize;
+        }
+        t->nbChunks = nbChunks;
+        t->firstChunk = (i < nbReaders) ? (int)((long long)i * nbChunks / nbReaders) : 0;
+        if (i < nbReaders) t->latencies = latencies + (size_t)i * MIXED_MAX_SAMPLES;
+    }
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i reader(s) decompressing, %i writer(s) compressing, %i blocks of %i KB, %li cpus online\n",
+            inFileName, nbReaders, nbWriters, nbChunks, chunkSize>>10, nbCpus);
+    if (nbCpus < count) DISPLAY("WARNING: more threads than online cpus, readers and writers will share cores\n");
+    DISPLAY("%-23.23s : %8s %8s %8s %8s %8s %6s %10s %10s\n", "read latency (us/block)", "p50", "p90", "p99", "p99.9", "max", "p99 x", "read MB/s", "write MB/s");
+
+    for (dAlgNb=0; (dAlgNb < NB_DECOMPRESSION_ALGORITHMS) && decompressionTest; dAlgNb++)
+    {
+        double aloneP99 = 0.;
+        if (!BMK_decompressorSelected(dAlgNb)) continue;
+        DISPLAY("%s\n", decompressionNames[dAlgNb]);
+
+        // cAlgNb == -1 : readers alone, the reference
+        for (cAlgNb=-1; cAlgNb < NB_COMPRESSION_ALGORITHMS; cAlgNb++)
+        {
+            double readSpeed, writeSpeed, p[5];
+            char label[40];
+            int nbSamples = 0;
+            static const double ranks[5] = { 0.5, 0.9, 0.99, 0.999, 1. };
+
+            if ((cAlgNb >= 0) && (!compressionTest || !BMK_compressorSelected(cAlgNb) || (nbWriters == 0))) continue;
+            snprintf(label, sizeof(label), "  %s%.30s", (cAlgNb < 0) ? "" : "+ ", (cAlgNb < 0) ? "alone" : compressionNames[cAlgNb]);
+            DISPLAY("%-23.23s :\r", label);
+            if (BMK_runMixed(threads, nbReaders, (cAlgNb < 0) ? 0 : nbWriters, dAlgNb, (cAlgNb < 0) ? 0 : cAlgNb, &readSpeed, &writeSpeed))
+            {
+                DISPLAY("ERROR ! %s failed under %s on %s !! \n", decompressionNames[dAlgNb], (cAlgNb < 0) ? "no load" : compressionNames[cAlgNb], inFileName);
+                exit(1);
+            }
+            for (i=0; i<nbReaders; i++)
+            {
+                if (memcmp(threads[i].chunkP[0].origBuffer, orig_buff, benchedSize))
+                    DISPLAY("\n!!! WARNING !!! %14s : %s output differs from the input in reader %i\n", inFileName, decompressionNames[dAlgNb], i);
+                // Gather every reader's samples after the first reader's
+                memmove(latencies + nbSamples, threads[i].latencies, threads[i].nbLatencies * sizeof(double));
+                nbSamples += threads[i].nbLatencies;
+            }
+            if (nbSamples == 0) continue;
+            qsort(latencies, nbSamples, sizeof(double), BMK_compareDouble);
+            for (n=0; n<5; n++) p[n] = latencies[(int)(ranks[n] * (nbSamples - 1))] / 1000.;
+            if (cAlgNb < 0) aloneP99 = p[2];
+            DISPLAY("%-23.23s : %8.1f %8.1f %8.1f %8.1f %8.1f %6.2f %10.1f ", label, p[0], p[1], p[2], p[3], p[4], aloneP99 ? p[2] / aloneP99 : 0., readSpeed);
+            if (cAlgNb < 0) DISPLAY("%10s\n", "-");
+            else DISPLAY("%10.1f\n", writeSpeed);
+        }
+    }
+
+_cleanup:
+    for (i=0; (threads!=NULL) && (i<count); i++)
+    {
+        if (threads[i].chunkP) free((i < nbReaders) ? threads[i].chunkP[0].origBuffer : threads[i].chunkP[0].compressedBuffer);
+        free(threads[i].chunkP);
+    }
+    free(threads);
+    free(shared);
+    free(sharedBuffer);
+    free(latencies);
+    return result;
+}
+#else
+static int BMK_threadBench(char* inFileName, char* orig_buff, size_t benchedSize, int nbChunks)
+{
+    (void)inFileName; (void)orig_buff; (void)benchedSize; (void)nbChunks;
+    DISPLAY("Concurrent workers are not supported on this platform\n");
+    return 1;
+}
+
+static int BMK_mixedBench(char* inFileName, char* orig_buff, size_t benchedSize, int nbChunks)
+{
+    (void)inFileName; (void)orig_buff; (void)benchedSize; (void)nbChunks;
+    DISPLAY("Concurrent readers and writers are not supported on this platform\n");
+    return 1;
+}
+#endif
+
+
+//*********************************************************
+//  Memory interference (noisy neighbours)
+//*********************************************************
+// Antagonist threads compete with the codecs for the LLC and DRAM bandwidth :
+//    copy   : memcpy() streams through up to 4 LLCs of memory
+//    chase  : follows a random cyclic list of cache lines over up to 4 LLCs, one miss at a time
+//    thrash : writes one byte per cache line of an LLC sized buffer, in a prefetcher unfriendly order
+// The intensity is the share of each millisecond an antagonist works; it sleeps for the rest.
+#define ANTAGONIST_NB_KINDS     3
+#define ANTAGONIST_PERIOD_NS    1000000
+#define ANTAGONIST_MAX_SIZE     ((size_t)256<<20)
+#define ANTAGONIST_COPY_STEP    4096
+#define ANTAGONIST_THRASH_STRIDE (61 * CACHELINE_SIZE)     // prime number of lines
+static const char* antagonistNames[ANTAGONIST_NB_KINDS] = { "copy", "chase", "thrash" };
+static const int antagonistLevels[] = { 25, 50, 100 };
+#define ANTAGONIST_NB_LEVELS    ((int)(sizeof(antagonistLevels) / sizeof(antagonistLevels[0])))
+
+#if !defined(BMK_NO_THREADS)
+struct antagonist
+{
+    pthread_t thread;
+    int    index;       // cpu index+1 of the pinned set under -P, the benchmark has the first
+    int    kind;        // ANTAGONIST_COPY, _CHASE or _THRASH
+    int    duty;        // % of each period spent working
+    char*  buffer;
+    size_t size;        // used by this kind, up to ANTAGONIST_MAX_SIZE
+    size_t sink;        // keeps the pointer chase alive
+};
+
+static volatile int antagonistStop = 0;
+
+static void BMK_antagonistChain(struct antagonist* a, U32 seed)
+{
+    // One random cycle over every cache line (Sattolo), each line holds the offset of the next
+    size_t nbLines = a->size / CACHELINE_SIZE, i;
+    U32* order = (U32*) malloc(nbLines * sizeof(U32));
+    if (order==NULL) { a->size = 0; return; }
+    for (i=0; i<nbLines; i++) order[i] = (U32)i;
+    for (i=nbLines-1; i>0; i--)
+    {
+        size_t j = BMK_rand(&seed) % i;
+        U32 tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+    }
+    for (i=0; i<nbLines; i++) *(size_t*)(a->buffer + (size_t)order[i] * CACHELINE_SIZE) = (size_t)order[(i+1) % nbLines] * CACHELINE_SIZE;
+    free(order);
+}
+
+static void* BMK_antagonist(void* arg)
+{
+    struct antagonist* a = (struct antagonist*) arg;
+    size_t half = a->size / 2, pos = 0;
+
+    BMK_pinThread(a->index + 1);
+
+    while (!antagonistStop)
+    {
+        U64 start = BMK_GetNanoTime();
+        U64 busy = (U64)ANTAGONIST_PERIOD_NS * a->duty / 100;
+        U64 spent;
+        do
+        {
+            int n;
+            // A few hundred KB of traffic between two clock reads
+            if (a->kind == ANTAGONIST_COPY)
+                for (n=0; n<64; n++)
+                {
+                    memcpy(a->buffer + half + pos, a->buffer + pos, ANTAGONIST_COPY_STEP);
+                    pos += ANTAGONIST_COPY_STEP;
+                    if (pos + ANTAGONIST_COPY_STEP > half) pos = 0;
+                }
+            if (a->kind == ANTAGONIST_CHASE)
+                for (n=0; n<1024; n++) a->sink = *(size_t*)(a->buffer + a->sink);
+            if (a->kind == ANTAGONIST_THRASH)
+                for (n=0; n<4096; n++)
+                {
+                    a->buffer[pos]++;
+                    pos += ANTAGONIST_THRASH_STRIDE;
+                    if (pos >= a->size) pos -= a->size;
+                }
+            spent = BMK_GetNanoTime() - start;
+        } while ((spent < busy) && !antagonistStop);
+        if (a->duty < 100)
+        {
+            struct timespec rest;
+            rest.tv_sec = 0;
+            rest.tv_nsec = (long)(ANTAGONIST_PERIOD_NS - ((spent < ANTAGONIST_PERIOD_NS) ? spent : ANTAGONIST_PERIOD_NS));
+            nanosleep(&rest, NULL);
+        }
+    }
+    return NULL;
+}
+
+static void BMK_benchCodecs(char* inFileName, struct chunkParameters* chunkP, int nbChunks, char* orig_buff, const char* reference, size_t benchedSize, U32 crcOriginal,
+                            double* speed, const char* label)
+{
+    // MB/s of every selected codec, compressors first. Each decoder works on a
+    // zeroed orig_buff, put back from reference once checked, so that neither
+    // the next decoder nor the next level depends on its output.
+    int algNb, nbSpeeds = 0;
+    for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+        if (BMK_compressorSelected(algNb)) speed[nbSpeeds++] = BMK_benchChunks(0, algNb, chunkP, nbChunks, inFileName);
+    BMK_prepareDecompression(chunkP, nbChunks);
+    for (algNb=0; (algNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); algNb++)
+    {
+        if (!BMK_decompressorSelected(algNb)) continue;
+        memset(orig_buff, 0, benchedSize);     // zeroing source area, for CRC checking
+        speed[nbSpeeds++] = BMK_benchChunks(1, algNb, chunkP, nbChunks, inFileName);
+        if (XXH32(orig_buff, (unsigned int)benchedSize, 0) != crcOriginal)
+            DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum with %s (%s)\n", inFileName, decompressionNames[algNb], label);
+        memcpy(orig_buff, reference, benchedSize);
+    }
+}
+
+static int BMK_antagonistBench(char* inFileName, struct chunkParameters* chunkP, int nbChunks, char* orig_buff, size_t benchedSize, U32 crcOriginal)
+{
+    double speed[1 + ANTAGONIST_NB_KINDS * ANTAGONIST_NB_LEVELS][NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS];
+    char labels[1 + ANTAGONIST_NB_KINDS * ANTAGONIST_NB_LEVELS][16];
+    struct antagonist* antagonists = (struct antagonist*) calloc(nbAntagonists, sizeof(struct antagonist));
+    size_t llc = BMK_getLLCSize();
+    size_t streamSize = (4*llc < ANTAGONIST_MAX_SIZE) ? 4*llc : ANTAGONIST_MAX_SIZE;
+    size_t thrashSize = ((llc < ANTAGONIST_MAX_SIZE) ? llc : ANTAGONIST_MAX_SIZE) & ~(size_t)(CACHELINE_SIZE - 1);
+    long nbCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    char* reference = (char*) malloc(benchedSize);
+    int kind, level, i, n, algNb, nbLevels = 0, result = 0;
+
+    if ((antagonists==NULL) || (reference==NULL)) { DISPLAY("\nError: not enough memory!\n"); free(antagonists); free(reference); return 12; }
+    memcpy(reference, orig_buff, benchedSize);
+    BMK_pinThread(0);     // the benchmark thread, antagonists on the next cpus
+    for (i=0; i<nbAntagonists; i++)
+    {
+        antagonists[i].buffer = (char*) malloc(streamSize);
+        if (antagonists[i].buffer==NULL) { DISPLAY("\nError: not enough memory for %i antagonists!\n", nbAntagonists); result = 12; goto _cleanup; }
+        memset(antagonists[i].buffer, 0, streamSize);
+    }
+
+    snprintf(labels[0], sizeof(labels[0]), "idle");
+    BMK_benchCodecs(inFileName, chunkP, nbChunks, orig_buff, reference, benchedSize, crcOriginal, speed[nbLevels++], labels[0]);
+
+    for (kind=0; kind<ANTAGONIST_NB_KINDS; kind++)
+    {
+        if (!(antagonistKinds & (1 << kind))) continue;
+        for (level=0; level<ANTAGONIST_NB_LEVELS; level++)
+        {
+            snprintf(labels[nbLevels], sizeof(labels[nbLevels]), "%s%i", antagonistNames[kind], antagonistLevels[level]);
+            antagonistStop = 0;
+            for (i=0; i<nbAntagonists; i++)
+            {
+                struct antagonist* a = &antagonists[i];
+                a->index = i;
+                a->kind = 1 << kind;
+                a->duty = antagonistLevels[level];
+                a->size = (a->kind == ANTAGONIST_THRASH) ? thrashSize : streamSize;
+                a->sink = 0;
+                if ((a->kind == ANTAGONIST_CHASE) && (level == 0)) BMK_antagonistChain(a, (U32)i + 1);
+                if (a->size == 0) { DISPLAY("\nError: not enough memory!\n"); result = 12; goto _cleanup; }
+            }
+            for (i=0; i<nbAntagonists; i++)
+                if (pthread_create(&antagonists[i].thread, NULL, BMK_antagonist, &antagonists[i]))
+                {
+                    DISPLAY("\nError: can not create antagonist thread %i\n", i);
+                    exit(1);
+                }
+            DISPLAY("%-8s\r", labels[nbLevels]);
+            BMK_benchCodecs(inFileName, chunkP, nbChunks, orig_buff, reference, benchedSize, crcOriginal, speed[nbLevels], labels[nbLevels]);
+            antagonistStop = 1;
+            for (i=0; i<nbAntagonists; i++) pthread_join(antagonists[i].thread, NULL);
+            nbLevels++;
+        }
+    }
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i blocks of %i KB, %i antagonist(s), %i MB streamed, %i MB thrashed each, %li cpus online\n", inFileName, nbChunks, chunkSize>>10,
+            nbAntagonists, (int)(streamSize>>20), (int)(thrashSize>>20), nbCpus);
+    if (nbCpus <= nbAntagonists) DISPLAY("WARNING: not a cpu per antagonist besides the benchmark, they also compete for cpu time\n");
+    DISPLAY("%-21.21s :", "(MB/s) antagonist %");
+    for (n=0; n<nbLevels; n++) DISPLAY(" %9s", labels[n]);
+    DISPLAY("   worst\n");
+    i = 0;
+    for (algNb=0; algNb < NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS; algNb++)
+    {
+        int decode = (algNb >= NB_COMPRESSION_ALGORITHMS);
+        int nb = decode ? algNb - NB_COMPRESSION_ALGORITHMS : algNb;
+        double worst = 0.;
+        if (decode ? (!decompressionTest || !BMK_decompressorSelected(nb)) : (!compressionTest || !BMK_compressorSelected(nb))) continue;
+        DISPLAY("%-21.21s :", decode ? decompressionNames[nb] : compressionNames[nb]);
+        for (n=0; n<nbLevels; n++)
+        {
+            double delta = (speed[n][i] / speed[0][i] - 1.) * 100.;
+            if (delta < worst) worst = delta;
+            DISPLAY(" %9.1f", speed[n][i]);
+        }
+        DISPLAY(" %+6.1f%%\n", worst);
+        i++;
+    }
+
+_cleanup:
+    antagonistStop = 1;
+    for (i=0; i<nbAntagonists; i++) free(antagonists[i].buffer);
+    free(antagonists);
+    free(reference);
+    return result;
+}
+#else
+static int BMK_antagonistBench(char* inFileName, struct chunkParameters* chunkP, int nbChunks, char* orig_buff, size_t benchedSize, U32 crcOriginal)
+{
+    (void)inFileName; (void)chunkP; (void)nbChunks; (void)orig_buff; (void)benchedSize; (void)crcOriginal;
+    DISPLAY("Antagonist threads are not supported on this platform\n");
+    return 1;
+}
+#endif
+
+
+//*********************************************************
+//  Page size and pre-faulting of benchmark buffers
+//*********************************************************
+#define PAGES_DEFAULT   0    // malloc, pages are faulted in by the first pass
+#define PAGES_LOCKED    1    // pre-faulted and mlocked
+#define PAGES_THP       2    // 2 MB aligned, madvise(MADV_HUGEPAGE), pre-faulted
+#define PAGES_HUGETLB   3    // mmap(MAP_HUGETLB) from the reserved pool (vm.nr_hugepages), pre-faulted
+#define NB_PAGE_MODES   4
+#define HUGE_PAGE_SIZE  (2<<20)
+static char* pageModeNames[] = { "4K pages", "locked", "THP", "hugetlb" };
+
+static void BMK_prefault(char* buffer, size_t size)
+{
+    size_t pos;
+    for (pos=0; pos<size; pos+=4096) buffer[pos] = 0;
+    if (size) buffer[size-1] = 0;
+}
+
+static char* BMK_allocBuffer(size_t size, int mode)
+{
+    char* buffer = NULL;
+    size_t hugeSize = (size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+
+#if defined(BMK_NO_MMAP)
+    (void)hugeSize;
+    if (mode != PAGES_DEFAULT) { buffer = (char*)malloc(size); if (buffer) BMK_prefault(buffer, size); return buffer; }
+#else
+    if (mode == PAGES_LOCKED)
+    {
+        buffer = (char*)malloc(size);
+        if (buffer==NULL) return NULL;
+        BMK_prefault(buffer, size);
+        if (mlock(buffer, size)) DISPLAY("\rWARNING: mlock() of %i MB failed (RLIMIT_MEMLOCK ?), pages are pre-faulted only\n", (int)(size>>20));
+        return buffer;
+    }
+    if (mode == PAGES_THP)
+    {
+        void* aligned;
+        if (posix_memalign(&aligned, HUGE_PAGE_SIZE, hugeSize)) return NULL;
+        buffer = (char*)aligned;
+#  if defined(MADV_HUGEPAGE)
+        madvise(buffer, hugeSize, MADV_HUGEPAGE);
+#  endif
+        BMK_prefault(buffer, hugeSize);
+        return buffer;
+    }
+    if (mode == PAGES_HUGETLB)
+    {
+#  if defined(MAP_HUGETLB)
+        void* mapped = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapped == MAP_FAILED) return NULL;
+        buffer = (char*)mapped;
+        BMK_prefault(buffer, hugeSize);
+#  endif
+        return buffer;
+    }
+#endif
+    return (char*)malloc(size);
+}
+
+static void BMK_freeBuffer(char* buffer, size_t size, int mode)
+{
+    if (buffer==NULL) return;
+#if !defined(BMK_NO_MMAP)
+    if (mode == PAGES_LOCKED) munlock(buffer, size);
+    if (mode == PAGES_HUGETLB)
+    {
+        munmap(buffer, (size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1));
+        return;
+    }
+#else
+    (void)size; (void)mode;
+#endif
+    free(buffer);
+}
+
+static void BMK_displayTHPSetting(void)
+{
+    char setting[128] = "unknown";
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f!=NULL)
+    {
+        if (fgets(setting, sizeof(setting), f)==NULL) strcpy(setting, "unknown");
+        fclose(f);
+    }
+    setting[strcspn(setting, "\r\n")] = 0;
+    DISPLAY("# transparent_hugepage : %s\n", setting);
+}
+
+static int BMK_pagesBench(char* inFileName, char* orig_buff, size_t benchedSize, U32 crcOriginal, int nbChunks)
+{
+    // Runs every selected codec on a private copy of the input, once per page mode,
+    // and reports each mode against default 4K pages.
+    double speed[NB_PAGE_MODES][NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS];
+    int available[NB_PAGE_MODES];
+    size_t compressedSize = (size_t)nbChunks * LZ4_compressBound(chunkSize);
+    size_t footprint = benchedSize + 3*compressedSize;
+    struct chunkParameters* chunkP = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+    int mode, algNb, nbSpeeds = 0, i;
+
+    if (chunkP==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+
+    for (mode=0; mode<NB_PAGE_MODES; mode++)
+    {
+        char* buffer = BMK_allocBuffer(footprint, mode);
+        char* copy;
+
+        nbSpeeds = 0;
+        available[mode] = (buffer!=NULL);
+        if (buffer==NULL)
+        {
+            DISPLAY("\r%s : %i MB allocation not available, skipped\n", pageModeNames[mode], (int)(footprint>>20));
+            continue;
+        }
+        copy = buffer;
+        memcpy(copy, orig_buff, benchedSize);
+        BMK_initChunks(chunkP, nbChunks, copy, benchedSize, copy + benchedSize, copy + benchedSize + compressedSize, copy + benchedSize + 2*compressedSize);
+
+        for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+            if (BMK_compressorSelected(algNb)) speed[mode][nbSpeeds++] = BMK_benchChunks(0, algNb, chunkP, nbChunks, inFileName);
+
+        BMK_prepareDecompression(chunkP, nbChunks);
+        memset(copy, 0, benchedSize);     // zeroing source area, for CRC checking
+        for (algNb=0; (algNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); algNb++)
+        {
+            if (!BMK_decompressorSelected(algNb)) continue;
+            speed[mode][nbSpeeds++] = BMK_benchChunks(1, algNb, chunkP, nbChunks, inFileName);
+            if (XXH32(copy, (unsigned int)benchedSize, 0) != crcOriginal)
+                DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum with %s (%s)\n", inFileName, decompressionNames[algNb], pageModeNames[mode]);
+        }
+
+        BMK_freeBuffer(buffer, footprint, mode);
+    }
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i blocks of %i KB, %i MB of buffers\n", inFileName, nbChunks, chunkSize>>10, (int)(footprint>>20));
+    BMK_displayTHPSetting();
+    DISPLAY("%-21.21s :", "(MB/s)");
+    for (mode=0; mode<NB_PAGE_MODES; mode++) DISPLAY(" %9s", pageModeNames[mode]);
+    for (mode=1; mode<NB_PAGE_MODES; mode++) DISPLAY(" %8.8s%%", pageModeNames[mode]);
+    DISPLAY("\n");
+
+    i = 0;
+    for (algNb=0; algNb < NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS; algNb++)
+    {
+        int decode = (algNb >= NB_COMPRESSION_ALGORITHMS);
+        int nb = decode ? algNb - NB_COMPRESSION_ALGORITHMS : algNb;
+        if (decode ? (!decompressionTest || !BMK_decompressorSelected(nb)) : (!compressionTest || !BMK_compressorSelected(nb))) continue;
+        DISPLAY("%-21.21s :", decode ? decompressionNames[nb] : compressionNames[nb]);
+        for (mode=0; mode<NB_PAGE_MODES; mode++)
+        {
+            if (available[mode]) DISPLAY(" %9.1f", speed[mode][i]);
+            else DISPLAY(" %9s", "-");
+        }
+        for (mode=1; mode<NB_PAGE_MODES; mode++)
+        {
+            if (available[mode] && available[PAGES_DEFAULT]) DISPLAY(" %+8.1f%%", (speed[mode][i] / speed[PAGES_DEFAULT][i] - 1.) * 100.);
+            else DISPLAY(" %9s", "-");
+        }
+        DISPLAY("\n");
+        i++;
+    }
+
+    free(chunkP);
+    return 0;
+}
+
+
+//*********************************************************
+//  Buffer alignment
+//*********************************************************
+// The arena hands out one page aligned slot per block, plus a chosen offset,
+// so that every block of a buffer sits at the same misalignment relative to
+// cache lines and pages. The sweep times each codec with its input, its
+// output, or both, moved by 0 to 63 bytes.
+#define ARENA_ALIGN     4096
+static const int defaultAlignOffsets[] = { 0, 1, 2, 4, 8, 16, 32, 63 };
+
+struct arena
+{
+    char*  buffer;      // as allocated
+    size_t size;
+    char*  base;        // first ARENA_ALIGN boundary
+    size_t used;
+};
+
+static size_t BMK_arenaSlot(size_t size)
+{
+    return (size + ALIGN_MAX + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static int BMK_arenaInit(struct arena* a, size_t size)
+{
+    a->size = size + ARENA_ALIGN;
+    a->buffer = BMK_allocBuffer(a->size, pageMode);
+    if (a->buffer == NULL) return 1;
+    a->base = (char*)(((size_t)a->buffer + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+    a->used = 0;
+    return 0;
+}
+
+static char* BMK_arenaAlloc(struct arena* a, size_t size, int misalign)
+{
+    char* ptr = a->base + a->used + misalign;
+    a->used += BMK_arenaSlot(size);
+    return ptr;
+}
+
+static void BMK_arenaFree(struct arena* a)
+{
+    BMK_freeBuffer(a->buffer, a->size, pageMode);
+}
+
+static void BMK_arenaChunks(struct arena* a, struct chunkParameters* chunkP, int nbChunks, const char* orig_buff, size_t benchedSize, int origMisalign, int compressedMisalign)
+{
+    // Same blocks as BMK_initChunks(), each in its own slot; the input data is copied in
+    int maxCompressedChunkSize = LZ4_compressBound(chunkSize);
+    size_t remaining = benchedSize;
+    int i;
+
+    a->used = 0;
+    for (i=0; i<nbChunks; i++)
+    {
+        chunkP[i].id = i;
+        chunkP[i].origSize = ((int)remaining > chunkSize) ? chunkSize : (int)remaining;
+        remaining -= chunkP[i].origSize;
+        chunkP[i].origBuffer = BMK_arenaAlloc(a, chunkSize, origMisalign);
+        chunkP[i].compressedBuffer = BMK_arenaAlloc(a, maxCompressedChunkSize, compressedMisalign);
+        chunkP[i].compressedSize = 0;
+        chunkP[i].compressedLZJBBuffer = BMK_arenaAlloc(a, maxCompressedChunkSize, compressedMisalign);
+        chunkP[i].compressedLZJBSize = 0;
+        chunkP[i].compressedZFSLZ4Buffer = BMK_arenaAlloc(a, maxCompressedChunkSize, compressedMisalign);
+        chunkP[i].compressedZFSLZ4Size = 0;
+        memcpy(chunkP[i].origBuffer, orig_buff + (size_t)i * chunkSize, chunkP[i].origSize);
+    }
+}
+
+static int BMK_alignBench(char* inFileName, char* orig_buff, size_t benchedSize, int nbChunks)
+{
+    static const char* sideNames[] = { "", "input", "output", "input and output" };
+    double speed[NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS][MAX_ALIGN_OFFSETS];
+    const int* offsets = nbAlignOffsets ? alignOffsets : defaultAlignOffsets;
+    int nbOffsets = nbAlignOffsets ? nbAlignOffsets : (int)(sizeof(defaultAlignOffsets) / sizeof(defaultAlignOffsets[0]));
+    struct chunkParameters* chunkP = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+    struct arena a;
+    int offsetNb, algNb, chunkNb;
+
+    if ((chunkP==NULL) || BMK_arenaInit(&a, (size_t)nbChunks * (BMK_arenaSlot(chunkSize) + 3*BMK_arenaSlot(LZ4_compressBound(chunkSize)))))
+    {
+        DISPLAY("\nError: not enough memory!\n");
+        free(chunkP);
+        return 12;
+    }
+
+    for (offsetNb=0; offsetNb<nbOffsets; offsetNb++)
+    {
+        int in = (alignSides & ALIGN_INPUT) ? offsets[offsetNb] : 0;
+        int out = (alignSides & ALIGN_OUTPUT) ? offsets[offsetNb] : 0;
+
+        // Compression reads the blocks and writes the compressed buffers
+        BMK_arenaChunks(&a, chunkP, nbChunks, orig_buff, benchedSize, in, out);
+        for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+        {
+            if (!BMK_compressorSelected(algNb)) continue;
+            DISPLAY("+%-2i ", offsets[offsetNb]);
+            speed[algNb][offsetNb] = BMK_benchChunks(0, algNb, chunkP, nbChunks, inFileName);
+        }
+
+        // Decompression reads the compressed buffers and writes the blocks
+        if (!decompressionTest) continue;
+        BMK_arenaChunks(&a, chunkP, nbChunks, orig_buff, benchedSize, out, in);
+        BMK_prepareDecompression(chunkP, nbChunks);
+        for (algNb=0; algNb < NB_DECOMPRESSION_ALGORITHMS; algNb++)
+        {
+            if (!BMK_decompressorSelected(algNb)) continue;
+            for (chunkNb=0; chunkNb<nbChunks; chunkNb++) memset(chunkP[chunkNb].origBuffer, 0, chunkP[chunkNb].origSize);
+            DISPLAY("+%-2i ", offsets[offsetNb]);
+            speed[NB_COMPRESSION_ALGORITHMS + algNb][offsetNb] = BMK_benchChunks(1, algNb, chunkP, nbChunks, inFileName);
+            for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+                if (memcmp(chunkP[chunkNb].origBuffer, orig_buff + (size_t)chunkNb * chunkSize, chunkP[chunkNb].origSize))
+                {
+                    DISPLAY("\n!!! WARNING !!! %14s : %s output differs from the input in block %i at offset +%i\n", inFileName, decompressionNames[algNb], chunkNb, offsets[offsetNb]);
+                    break;
+                }
+        }
+    }
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i blocks of %i KB, MB/s with the %s at +# bytes from a page boundary\n", inFileName, nbChunks, chunkSize>>10, sideNames[alignSides]);
+    DISPLAY("%-21.21s :", "offset");
+    for (offsetNb=0; offsetNb<nbOffsets; offsetNb++) DISPLAY(" %7i", offsets[offsetNb]);
+    DISPLAY("   worst\n");
+    for (algNb=0; algNb < NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS; algNb++)
+    {
+        int decode = (algNb >= NB_COMPRESSION_ALGORITHMS);
+        int nb = decode ? algNb - NB_COMPRESSION_ALGORITHMS : algNb;
+        double worst = 0.;
+        if (decode ? (!decompressionTest || !BMK_decompressorSelected(nb)) : (!compressionTest || !BMK_compressorSelected(nb))) continue;
+        DISPLAY("%-21.21s :", decode ? decompressionNames[nb] : compressionNames[nb]);
+        for (offsetNb=0; offsetNb<nbOffsets; offsetNb++)
+        {
+            double delta = (speed[algNb][offsetNb] / speed[algNb][0] - 1.) * 100.;
+            if (delta < worst) worst = delta;
+            DISPLAY(" %7.1f", speed[algNb][offsetNb]);
+        }
+        DISPLAY(" %+6.1f%%\n", worst);
+    }
+    if (offsets[0] != 0) DISPLAY("(worst : against offset %i)\n", offsets[0]);
+
+    BMK_arenaFree(&a);
+    free(chunkP);
+    return 0;
+}
+
+
+//*********************************************************
+//  Compressor x decompressor matrix
+//*********************************************************
+// Every selected compressor feeds every selected decompressor of the same
+// format. Decoding is checked against the input and timed for each pair,
+// as decode speed depends on the choices the encoder made.
+// ZFS compressors return the input size for a block they can not shrink :
+// such blocks are stored, and left out of the decode timing unless the
+// caller asks for them to be counted as the copy a read of them costs.
+#define MATRIX_FAILED   (-1.)
+#define MATRIX_NO_MEMORY  (-2)
+
+static double BMK_storedCopyTime(struct chunkParameters* storedP, int nbStored, int format)
+{
+    // Fastest time (ns) of one pass copying the stored blocks, over nbIterations loops
+    double best = 0.;
+    int loopNb, chunkNb;
+
+    if (nbStored == 0) return 0.;
+    for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+    {
+        U64 nanos;
+        int nbLoops = 0;
+        int milliTime = BMK_GetMilliStart();
+        while(BMK_GetMilliStart() == milliTime);
+        milliTime = BMK_GetMilliStart();
+        nanos = BMK_GetNanoTime();
+        while (BMK_GetMilliSpan(milliTime) < TIMELOOP)
+        {
+            for (chunkNb=0; chunkNb<nbStored; chunkNb++)
+            {
+                int* storedSize;
+                memcpy(BMK_referenceStream(&storedP[chunkNb], format, &storedSize), storedP[chunkNb].origBuffer, storedP[chunkNb].origSize);
+            }
+            nbLoops++;
+        }
+        nanos = BMK_GetNanoTime() - nanos;
+        if ((best == 0.) || ((double)nanos / nbLoops < best)) best = (double)nanos / nbLoops;
+    }
+    return best;
+}
+
+static int BMK_matrixMeasure(char* inFileName, char* orig_buff, size_t benchedSize, int nbChunks,
+                             double speed[][NB_DECOMPRESSION_ALGORITHMS], double* ratio, int* nbStored, double* cSpeed, int withStored)
+{
+    // Decode MB/s of every pair and ratio of every compressor, and compress MB/s
+    // when cSpeed is not NULL; returns the number of failed pairs, < 0 on error.
+    // With withStored, decode MB/s covers every block, stored ones as a memcpy.
+    size_t compressedSize = (size_t)nbChunks * LZ4_compressBound(chunkSize);
+    size_t footprint = benchedSize + 3*compressedSize;
+    char* copy = BMK_allocBuffer(footprint, pageMode);
+    struct chunkParameters* chunkP = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+    struct chunkParameters* codedP = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+    int cAlgNb, dAlgNb, chunkNb, nbFailures = 0;
+
+    if ((copy==NULL) || (chunkP==NULL) || (codedP==NULL))
+    {
+        DISPLAY("\nError: not enough memory!\n");
+        BMK_freeBuffer(copy, footprint, pageMode);
+        free(chunkP); free(codedP);
+        return MATRIX_NO_MEMORY;
+    }
+    BMK_initChunks(chunkP, nbChunks, copy, benchedSize, copy + benchedSize, copy + benchedSize + compressedSize, copy + benchedSize + 2*compressedSize);
+
+    for (cAlgNb=0; cAlgNb<NB_COMPRESSION_ALGORITHMS; cAlgNb++)
+    {
+        char* cName = compressionNames[cAlgNb];
+        compressor_t compressionFunction;
+        initializer_t initFunction;
+        size_t cSize = 0, codedBytes = 0;
+        double storedNanos;
+        int nbCoded = 0;
+
+        for (dAlgNb=0; dAlgNb<NB_DECOMPRESSION_ALGORITHMS; dAlgNb++) speed[cAlgNb][dAlgNb] = 0.;
+        nbStored[cAlgNb] = 0;
+        if (!BMK_compressorSelected(cAlgNb)) continue;
+        if (BMK_selectCompressor(cAlgNb, &compressionFunction, &initFunction)) { nbFailures = -1; break; }
+
+        // Encode once, into the buffer the decoders of this format read
+        DISPLAY("%-21.21s : encoding\r", cName);
+        memcpy(copy, orig_buff, benchedSize);
+        if (cSpeed != NULL) cSpeed[cAlgNb] = BMK_benchChunks(0, cAlgNb, chunkP, nbChunks, inFileName);
+        if (initFunction!=NULL) ctx = initFunction(chunkP[0].origBuffer);
+        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+        {
+            struct chunkParameters* chunk = &chunkP[chunkNb];
+            int* codedSize;
+            char* coded = BMK_referenceStream(chunk, compressionFormats[cAlgNb], &codedSize);
+            int size = compressionFunction(chunk->origBuffer, coded, chunk->origSize);
+            if (size==0) DISPLAY("ERROR ! %s() = 0 !! \n", cName), exit(1);
+            *codedSize = size;
+            // Stored blocks fill codedP from its end
+            if ((compressionFormats[cAlgNb] != FORMAT_LZ4) && (size >= chunk->origSize)) { cSize += chunk->origSize; codedP[nbChunks - ++nbStored[cAlgNb]] = *chunk; continue; }
+            cSize += size;
+            codedBytes += chunk->origSize;
+            codedP[nbCoded++] = *chunk;
+        }
+        if (initFunction!=NULL) free(ctx);
+        ratio[cAlgNb] = (double)cSize / benchedSize * 100.;
+        storedNanos = withStored ? BMK_storedCopyTime(codedP + nbChunks - nbStored[cAlgNb], nbStored[cAlgNb], compressionFormats[cAlgNb]) : 0.;
+
+        for (dAlgNb=0; dAlgNb<NB_DECOMPRESSION_ALGORITHMS; dAlgNb++)
+        {
+            if ((decompressionFormats[dAlgNb] != compressionFormats[cAlgNb]) || !BMK_decompressorSelected(dAlgNb)) continue;
+            if (nbCoded==0) { if (withStored) speed[cAlgNb][dAlgNb] = (double)benchedSize * 1000. / storedNanos; continue; }
+
+            // Decode in place over a zeroed copy, then compare every block with the input
+            for (chunkNb=0; chunkNb<nbCoded; chunkNb++) memset(codedP[chunkNb].origBuffer, 0, codedP[chunkNb].origSize);
+            speed[cAlgNb][dAlgNb] = BMK_benchChunks(1, dAlgNb, codedP, nbCoded, inFileName);
+            for (chunkNb=0; chunkNb<nbCoded; chunkNb++)
+            {
+                size_t offset = (size_t)codedP[chunkNb].id * chunkSize;
+                if (memcmp(codedP[chunkNb].origBuffer, orig_buff + offset, codedP[chunkNb].origSize))
+                {
+                    DISPLAY("\n!!! WARNING !!! %14s : %s output decoded by %s differs from the input in block %i\n",
+                            inFileName, cName, decompressionNames[dAlgNb], (int)codedP[chunkNb].id);
+                    compareBufferToFile(codedP[chunkNb].origBuffer, codedP[chunkNb].origSize, inFileName, (int)offset);
+                    speed[cAlgNb][dAlgNb] = MATRIX_FAILED;
+                    nbFailures++;
+                    break;
+                }
+            }
+            if (withStored && nbStored[cAlgNb] && (speed[cAlgNb][dAlgNb] > 0.))
+                speed[cAlgNb][dAlgNb] = (double)benchedSize * 1000. / ((double)codedBytes * 1000. / speed[cAlgNb][dAlgNb] + storedNanos);
+        }
+    }
+
+    BMK_freeBuffer(copy, footprint, pageMode);
+    free(chunkP);
+    free(codedP);
+    return nbFailures;
+}
+
+static int BMK_matrixBench(char* inFileName, char* orig_buff, size_t benchedSize, int nbChunks)
+{
+    double speed[NB_COMPRESSION_ALGORITHMS][NB_DECOMPRESSION_ALGORITHMS];
+    double ratio[NB_COMPRESSION_ALGORITHMS];
+    int nbStored[NB_COMPRESSION_ALGORITHMS];
+    int cAlgNb, dAlgNb, format;
+    int nbFailures = BMK_matrixMeasure(inFileName, orig_buff, benchedSize, nbChunks, speed, ratio, nbStored, NULL, 0);
+
+    if (nbFailures == MATRIX_NO_MEMORY) return 12;
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i blocks of %i KB, decode MB/s of each compressor x decompressor pair\n", inFileName, nbChunks, chunkSize>>10);
+    for (format=0; (format<NB_FORMATS) && (nbFailures>=0); format++)
+    {
+        int header = 0;
+        for (cAlgNb=0; cAlgNb<NB_COMPRESSION_ALGORITHMS; cAlgNb++)
+        {
+            if ((compressionFormats[cAlgNb] != format) || !BMK_compressorSelected(cAlgNb)) continue;
+            if (!header)
+            {
+                DISPLAY("%-21.21s   ratio  ", formatNames[format]);
+                for (dAlgNb=0; dAlgNb<NB_DECOMPRESSION_ALGORITHMS; dAlgNb++)
+                    if ((decompressionFormats[dAlgNb] == format) && BMK_decompressorSelected(dAlgNb)) DISPLAY(" %21.21s", decompressionNames[dAlgNb]);
+                DISPLAY("\n");
+                header = 1;
+            }
+            DISPLAY("%-21.21s : %6.2f%%", compressionNames[cAlgNb], ratio[cAlgNb]);
+            for (dAlgNb=0; dAlgNb<NB_DECOMPRESSION_ALGORITHMS; dAlgNb++)
+            {
+                if ((decompressionFormats[dAlgNb] != format) || !BMK_decompressorSelected(dAlgNb)) continue;
+                if (speed[cAlgNb][dAlgNb] == MATRIX_FAILED) DISPLAY(" %21s", "FAILED");
+                else if (speed[cAlgNb][dAlgNb] == 0.) DISPLAY(" %21s", "-");     // every block stored
+                else DISPLAY(" %21.1f", speed[cAlgNb][dAlgNb]);
+            }
+            if (nbStored[cAlgNb]) DISPLAY("   (%i blocks stored)", nbStored[cAlgNb]);
+            DISPLAY("\n");
+        }
+    }
+
+    if (nbFailures < 0) return 1;
+    return nbFailures ? 15 : 0;
+}
+
+
+//*********************************************************
+//  Host and build fingerprint
+//*********************************************************
+// Results are only comparable between identical hosts and builds : the cpu,
+// its caches, the kernel, the compiler and the flags of this variant (the
+// Makefile defines FULLBENCH_BUILD) head every report and result file.
+#define RESULT_CPU   "# cpu : "
+#define RESULT_HOST  "# host : "
+#define RESULT_BUILD "# build : "
+
+#if !defined(FULLBENCH_BUILD)
+#  define FULLBENCH_BUILD "flags not recorded"
+#endif
+#define BMK_STRINGIFY(s) BMK_STRINGIFY2(s)
+#define BMK_STRINGIFY2(s) #s
+#if defined(__GNUC__) && !defined(__clang__)
+#  define BMK_COMPILER "gcc " __VERSION__
+#elif defined(__VERSION__)
+#  define BMK_COMPILER __VERSION__
+#elif defined(_MSC_VER)
+#  define BMK_COMPILER "MSVC " BMK_STRINGIFY(_MSC_VER)
+#else
+#  define BMK_COMPILER "unknown compiler"
+#endif
+
+struct hostFingerprint
+{
+    char cpu[256];      // brand, features and caches
+    char host[192];     // kernel and machine
+    char build[384];    // variant flags, compiler, word size
+};
+
+static struct hostFingerprint fingerprint;
+
+#if defined(__linux__)
+static int BMK_readSysfs(const char* path, char* value, int size)
+{
+    FILE* f = fopen(path, "r");
+    if (f==NULL) return 1;
+    if (fgets(value, size, f) == NULL) { fclose(f); return 1; }
+    fclose(f);
+    value[strcspn(value, "\n")] = 0;
+    return 0;
+}
+
+#endif
+
+static void BMK_cpuBrand(char* text, int size, char* features, int fsize)
+{
+#if defined(BMK_HAS_CPUID)
+    static const struct { int leaf; int reg; int bit; const char* name; } flags[] =
+    {
+        { 1, 3, 26, "sse2" }, { 1, 2, 0, "sse3" }, { 1, 2, 9, "ssse3" }, { 1, 2, 19, "sse4.1" },
+        { 1, 2, 20, "sse4.2" }, { 1, 2, 23, "popcnt" }, { 1, 2, 28, "avx" }, { 7, 1, 3, "bmi1" },
+        { 7, 1, 5, "avx2" }, { 7, 1, 8, "bmi2" }, { 7, 1, 9, "erms" }, { 7, 1, 16, "avx512f" }, { 7, 1, 30, "avx512bw" }
+    };
+    unsigned int regs[3][4], maxLeaf, brand[12];
+    int i, n = 0;
+
+    memset(regs, 0, sizeof(regs));
+    maxLeaf = __get_cpuid_max(0, NULL);
+    if (maxLeaf >= 1) __get_cpuid(1, &regs[1][0], &regs[1][1], &regs[1][2], &regs[1][3]);
+    if (maxLeaf >= 7) __get_cpuid_count(7, 0, &regs[2][0], &regs[2][1], &regs[2][2], &regs[2][3]);
+    features[0] = 0;
+    for (i=0; i<(int)(sizeof(flags)/sizeof(flags[0])); i++)
+    {
+        unsigned int reg = regs[flags[i].leaf == 1 ? 1 : 2][flags[i].reg];
+        if ((reg >> flags[i].bit) & 1) n += snprintf(features+n, fsize-n, "%s%s", n ? " " : "", flags[i].name);
+        if (n >= fsize) break;
+    }
+
+    memset(brand, 0, sizeof(brand));
+    if (__get_cpuid_max(0x80000000, NULL) >= 0x80000004)
+        for (i=0; i<3; i++) __get_cpuid(0x80000002 + i, &brand[i*4], &brand[i*4+1], &brand[i*4+2], &brand[i*4+3]);
+    {
+        char* b = (char*)brand;
+        b[sizeof(brand)-1] = 0;
+        while (*b == ' ') b++;
+        snprintf(text, size, "%s", *b ? b : "unknown x86");
+    }
+#elif defined(__linux__)
+    // Other architectures tell their model in /proc/cpuinfo, under one of these names
+    char line[256];
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    snprintf(text, size, "unknown");
+    snprintf(features, fsize, "not probed");
+    if (f==NULL) return;
+    while (fgets(line, sizeof(line), f))
+    {
+        char* value = strchr(line, ':');
+        if ((value==NULL) || (strncmp(line, "model name", 10) && strncmp(line, "Hardware", 8) && strncmp(line, "cpu model", 9) && strncmp(line, "cpu\t", 4))) continue;
+        value++;
+        while (*value == ' ') value++;
+        value[strcspn(value, "\n")] = 0;
+        snprintf(text, size, "%s", value);
+        break;
+    }
+    fclose(f);
+#else
+    snprintf(text, size, "unknown");
+    snprintf(features, fsize, "not probed");
+#endif
+}
+
+static void BMK_cacheTopology(char* text, int size)
+{
+    // Every cache level and type of cpu0, as sysfs names their sizes
+    int n = 0;
+#if defined(__linux__)
+    int idx;
+    for (idx=0; (idx<16) && (n<size); idx++)
+    {
+        char path[96], level[8], type[32], cacheSize[16];
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%i/level", idx);
+        if (BMK_readSysfs(path, level, sizeof(level))) break;
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%i/type", idx);
+        if (BMK_readSysfs(path, type, sizeof(type))) continue;
+        sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%i/size", idx);
+        if (BMK_readSysfs(path, cacheSize, sizeof(cacheSize))) continue;
+        n += snprintf(text+n, size-n, "%sL%s%s %s", n ? " " : "", level,
+                      !strcmp(type, "Data") ? "d" : !strcmp(type, "Instruction") ? "i" : "", cacheSize);
+    }
+#endif
+    if (n == 0) snprintf(text, size, "unknown");
+}
+
+static void BMK_fingerprint(void)
+{
+    char brand[96], features[128], caches[96];
+
+    BMK_cpuBrand(brand, sizeof(brand), features, sizeof(features));
+    BMK_cacheTopology(caches, sizeof(caches));
+    snprintf(fingerprint.cpu, sizeof(fingerprint.cpu), "%s, features %s, caches %s", brand, features, caches);
+
+#if !defined(_WIN32)
+    {
+        struct utsname name;
+        if (uname(&name)) snprintf(fingerprint.host, sizeof(fingerprint.host), "unknown");
+        else snprintf(fingerprint.host, sizeof(fingerprint.host), "%.32s %.64s %.64s %.16s", name.sysname, name.release, name.version, name.machine);
+    }
+#else
+    snprintf(fingerprint.host, sizeof(fingerprint.host), "Windows");
+#endif
+
+    snprintf(fingerprint.build, sizeof(fingerprint.build), "%s, %s, %i-bits", FULLBENCH_BUILD, BMK_COMPILER, (int)(sizeof(void*)*8));
+
+    DISPLAY("- cpu : %s -\n", fingerprint.cpu);
+    DISPLAY("- host : %s -\n", fingerprint.host);
+    DISPLAY("- build : %s -\n", fingerprint.build);
+}
+
+
+//*********************************************************
+//  Benchmark isolation
+//*********************************************************
+// fullbench pins itself (-P) and can run SCHED_FIFO (-F), instead of relying
+// on taskset and nice. The frequency governor, turbo state, frequency and load
+// are recorded with the results; a noisy environment is reported, or refused (-S).
+struct benchConditions
+{
+    int    cpu;             // first pinned cpu, -1 : not pinned
+    int    nbCpus;          // pinned cpus, one per worker
+    int    freqCpu;         // cpu the governor and frequency are read from
+    char   scheduler[16];
+    char   governor[32];
+    int    turbo;           // -1 : unknown
+    long   freq;            // kHz, at start, 0 : unknown
+    long   endFreq;         // kHz, when results are saved
+    long   maxFreq;         // kHz
+    double load;            // 1 minute load average
+    int    running;         // runnable tasks, fullbench included
+};
+
+static struct benchConditions conditions = { -1, 0, 0, "normal", "unknown", -1, 0, 0, 0, 0., 0 };
+
+#if defined(__linux__)
+static long BMK_cpuFrequency(int cpu, const char* file)
+{
+    char path[96], value[32];
+    sprintf(path, "/sys/devices/system/cpu/cpu%i/cpufreq/%s", cpu, file);
+    if (BMK_readSysfs(path, value, sizeof(value))) return 0;
+    return atol(value);
+}
+
+static void BMK_readConditions(int cpu)
+{
+    char value[32];
+    char path[96];
+    FILE* f;
+
+    conditions.freqCpu = cpu;
+    sprintf(path, "/sys/devices/system/cpu/cpu%i/cpufreq/scaling_governor", cpu);
+    BMK_readSysfs(path, conditions.governor, sizeof(conditions.governor));
+    conditions.freq = BMK_cpuFrequency(cpu, "scaling_cur_freq");
+    conditions.maxFreq = BMK_cpuFrequency(cpu, "cpuinfo_max_freq");
+
+    // intel_pstate tells no_turbo, acpi-cpufreq and amd-pstate tell boost
+    if (!BMK_readSysfs("/sys/devices/system/cpu/intel_pstate/no_turbo", value, sizeof(value))) conditions.turbo = (atoi(value) == 0);
+    else if (!BMK_readSysfs("/sys/devices/system/cpu/cpufreq/boost", value, sizeof(value))) conditions.turbo = (atoi(value) != 0);
+
+    f = fopen("/proc/loadavg", "r");
+    if (f!=NULL)
+    {
+        if (fscanf(f, "%lf %*f %*f %i/", &conditions.load, &conditions.running) != 2) conditions.running = 0;
+        fclose(f);
+    }
+}
+#endif
+
+static void BMK_describeConditions(char* text, int size)
+{
+    char cpus[32] = "not pinned", turbo[16] = "unknown", freq[48] = "unknown";
+
+    if (conditions.nbCpus == 1) sprintf(cpus, "cpu %i", conditions.cpu);
+    if (conditions.nbCpus > 1) sprintf(cpus, "cpus %i-%i", conditions.cpu, conditions.cpu + conditions.nbCpus - 1);
+
+    if (conditions.turbo >= 0) sprintf(turbo, "%s", conditions.turbo ? "on" : "off");
+    if (conditions.freq)
+    {
+        int n = sprintf(freq, "%li MHz", conditions.freq / 1000);
+        if (conditions.endFreq) n += sprintf(freq+n, " -> %li MHz", conditions.endFreq / 1000);
+        if (conditions.maxFreq) sprintf(freq+n, " (max %li)", conditions.maxFreq / 1000);
+    }
+    snprintf(text, size, "%s, %s, governor %s, turbo %s, freq %s, load %.2f", cpus, conditions.scheduler, conditions.governor, turbo, freq, conditions.load);
+}
+
+static int BMK_isolate(void)
+{
+    // Applies -P and -F, then reads and checks the conditions of the run
+    int nbWarnings = 0;
+    char text[256];
+
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+
+    if (cpu < 0) cpu = 0;
+    if (pinCPU != PIN_NONE)
+    {
+        // One cpu per thread : the process gets the whole set, and each worker
+        // or antagonist pins itself to its own cpu of it (BMK_pinThread())
+        cpu_set_t set;
+        int n, nbCpus = (benchMode == MODE_THREADS) ? nbWorkers : (benchMode == MODE_ANTAGONIST) ? nbAntagonists + 1 : 1;
+
+        if (pinCPU != PIN_CURRENT) cpu = pinCPU;
+        CPU_ZERO(&set);
+        for (n=0; n<nbCpus; n++) CPU_SET(cpu + n, &set);
+        if (sched_setaffinity(0, sizeof(set), &set))
+        {
+            DISPLAY("WARNING: can not pin to %i cpu(s) from cpu %i (%s)\n", nbCpus, cpu, strerror(errno));
+            pinCPU = PIN_NONE;
+            nbWarnings++;
+        }
+        else
+        {
+            pinCPU = cpu;
+            // cpus which do not exist are silently left out of the set
+            sched_getaffinity(0, sizeof(set), &set);
+            conditions.cpu = cpu;
+            conditions.nbCpus = CPU_COUNT(&set);
+            if (conditions.nbCpus < nbCpus) { DISPLAY("WARNING: only %i of %i cpu(s) from cpu %i could be pinned\n", conditions.nbCpus, nbCpus, cpu); nbWarnings++; }
+        }
+    }
+
+    if (schedFifo)
+    {
+        // Lowest real time priority : above every normal task, below kernel threads
+        struct sched_param param;
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        if (!sched_setscheduler(0, SCHED_FIFO, &param)) sprintf(conditions.scheduler, "SCHED_FIFO");
+        else if (!setpriority(PRIO_PROCESS, 0, -20)) sprintf(conditions.scheduler, "nice -20");
+        else
+        {
+            DISPLAY("WARNING: can not raise to SCHED_FIFO (%s)\n", strerror(errno));
+            nbWarnings++;
+        }
+    }
+
+    BMK_readConditions(cpu);
+    if (strcmp(conditions.governor, "unknown") && strcmp(conditions.governor, "performance"))
+    {
+        DISPLAY("WARNING: cpu %i frequency governor is '%s', not 'performance'\n", cpu, conditions.governor);
+        nbWarnings++;
+    }
+    if (conditions.turbo > 0)
+    {
+        DISPLAY("WARNING: turbo is on, the frequency depends on temperature and on the other cores\n");
+        nbWarnings++;
+    }
+    if (conditions.load > NOISY_LOAD)
+    {
+        DISPLAY("WARNING: system is busy, load %.2f, %i runnable task(s) now\n", conditions.load, conditions.running);
+        nbWarnings++;
+    }
+#else
+    if ((pinCPU != PIN_NONE) || schedFifo) DISPLAY("- pinning and SCHED_FIFO are not supported on this platform -\n");
+#endif
+
+    BMK_describeConditions(text, sizeof(text));
+    DISPLAY("- conditions : %s -\n", text);
+    if (nbWarnings && strictIsolation)
+    {
+        DISPLAY("Error: noisy environment, %i warning(s), benchmark refused (-S)\n", nbWarnings);
+        return NOISY_EXIT_CODE;
+    }
+    return 0;
+}
+
+static void BMK_endConditions(void)
+{
+    // The frequency once the run is over shows throttling during the run
+#if defined(__linux__)
+    if (conditions.freq) conditions.endFreq = BMK_cpuFrequency(conditions.freqCpu, "scaling_cur_freq");
+#endif
+}
+
+
+//*********************************************************
+//  NUMA placement
+//*********************************************************
+// The thread, the codec input (src) and the codec output (dst) are each
+// bound to a node : the thread with the cpus of its node, plus a preferred
+// node for what the codecs allocate (set_mempolicy), the buffers with
+// mbind() before their pages are first touched. Compression reads the
+// blocks and writes compressed data, decompression the other way around,
+// so both directions get their input on src and their output on dst.
+#define BMK_MPOL_DEFAULT    0
+#define BMK_MPOL_PREFERRED  1
+#define BMK_MPOL_BIND       2
+#define BMK_MPOL_F_NODE     1
+#define BMK_MPOL_F_ADDR     2
+#define BMK_MPOL_MF_STRICT  1
+#define BMK_MPOL_MF_MOVE    2
+
+#if !defined(BMK_NO_NUMA)
+static void BMK_parseCpuList(const char* list, cpu_set_t* set)
+{
+    // sysfs cpu lists, like "0-7,16-23"
+    CPU_ZERO(set);
+    while (*list)
+    {
+        char* end;
+        long first = strtol(list, &end, 10), last;
+        if (end == list) break;
+        last = first;
+        if (*end == '-') last = strtol(end+1, &end, 10);
+        for ( ; (first <= last) && (first < CPU_SETSIZE); first++) CPU_SET(first, set);
+        if (*end != ',') break;
+        list = end + 1;
+    }
+}
+
+static int BMK_numaNodes(cpu_set_t* nodeCpus)
+{
+    // Nodes are numbered from 0 without holes here; a machine without
+    // NUMA support in its kernel is one node of every cpu
+    int nbNodes;
+    for (nbNodes=0; nbNodes<NUMA_MAX_NODES; nbNodes++)
+    {
+        char path[64], list[1024];
+        sprintf(path, "/sys/devices/system/node/node%i/cpulist", nbNodes);
+        if (BMK_readSysfs(path, list, sizeof(list))) break;
+        BMK_parseCpuList(list, &nodeCpus[nbNodes]);
+    }
+    if (nbNodes == 0)
+    {
+        sched_getaffinity(0, sizeof(nodeCpus[0]), &nodeCpus[0]);
+        nbNodes = 1;
+    }
+    return nbNodes;
+}
+
+static char* BMK_numaAlloc(size_t size, int node, int* bound)
+{
+    // *bound is cleared when the kernel refuses the policy : the pages then land anywhere
+    unsigned long mask = 1UL << node;
+    void* buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) return NULL;
+    if (syscall(SYS_mbind, buffer, size, BMK_MPOL_BIND, &mask, sizeof(mask)*8, BMK_MPOL_MF_STRICT | BMK_MPOL_MF_MOVE))
+    {
+        if (*bound) DISPLAY("\rWARNING: mbind() to node %i failed (%s), buffers are not bound\n", node, strerror(errno));
+        *bound = 0;
+    }
+    BMK_prefault((char*)buffer, size);
+    return (char*)buffer;
+}
+
+static int BMK_numaNodeOf(const void* ptr)
+{
+    // Node of the page holding ptr, -1 if unknown
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, NULL, 0, ptr, BMK_MPOL_F_NODE | BMK_MPOL_F_ADDR)) return -1;
+    return node;
+}
+
+static int BMK_numaBench(char* inFileName, char* orig_buff, size_t benchedSize, U32 crcOriginal, int nbChunks)
+{
+    double speed[NUMA_MAX_NODES * NUMA_MAX_NODES][NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS];
+    cpu_set_t nodeCpus[NUMA_MAX_NODES], original;
+    size_t compressedSize = (size_t)nbChunks * LZ4_compressBound(chunkSize);
+    size_t footprint = benchedSize + 3*compressedSize;
+    struct chunkParameters* chunkP = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+    int nbNodes = BMK_numaNodes(nodeCpus);
+    int threadNode = numaThreadNode, bound = 1, placed = 1;
+    int src, dst, algNb, i, nbPlacements = 0, local = -1;
+    int placements[NUMA_MAX_NODES * NUMA_MAX_NODES];
+
+    if (chunkP==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+    if ((threadNode >= nbNodes) || (numaSrcNode >= nbNodes) || (numaDstNode >= nbNodes))
+    {
+        DISPLAY("Error: this machine has %i NUMA node(s), numbered from 0\n", nbNodes);
+        free(chunkP);
+        return 1;
+    }
+    if (threadNode == NUMA_ANY)
+    {
+        int cpu = sched_getcpu();
+        for (threadNode=nbNodes-1; threadNode>0; threadNode--) if ((cpu >= 0) && CPU_ISSET(cpu, &nodeCpus[threadNode])) break;
+    }
+
+    sched_getaffinity(0, sizeof(original), &original);
+    if (sched_setaffinity(0, sizeof(nodeCpus[threadNode]), &nodeCpus[threadNode]))
+        DISPLAY("WARNING: can not run on the cpus of node %i (%s)\n", threadNode, strerror(errno));
+    if (nbNodes > 1)
+    {
+        unsigned long mask = 1UL << threadNode;
+        if (syscall(SYS_set_mempolicy, BMK_MPOL_PREFERRED, &mask, sizeof(mask)*8))
+            DISPLAY("WARNING: set_mempolicy() to node %i failed (%s)\n", threadNode, strerror(errno));
+    }
+
+    for (src=0; src<nbNodes; src++)
+    for (dst=0; dst<nbNodes; dst++)
+    {
+        char* srcBuffer;
+        char* dstBuffer;
+        int nbSpeeds = 0;
+
+        if ((numaSrcNode != NUMA_ANY) && (src != numaSrcNode)) continue;
+        if ((numaDstNode != NUMA_ANY) && (dst != numaDstNode)) continue;
+        srcBuffer = BMK_numaAlloc(footprint, src, &bound);
+        dstBuffer = BMK_numaAlloc(footprint, dst, &bound);
+        if ((srcBuffer==NULL) || (dstBuffer==NULL))
+        {
+            DISPLAY("\nError: not enough memory!\n");
+            if (srcBuffer) munmap(srcBuffer, footprint);
+            if (dstBuffer) munmap(dstBuffer, footprint);
+            free(chunkP);
+            return 12;
+        }
+        if (bound && (nbNodes > 1) && ((BMK_numaNodeOf(srcBuffer) != src) || (BMK_numaNodeOf(dstBuffer) != dst))) placed = 0;
+        if ((src == threadNode) && (dst == threadNode)) local = nbPlacements;
+        placements[nbPlacements] = src * NUMA_MAX_NODES + dst;
+
+        // Compression : blocks on src, compressed data on dst
+        memcpy(srcBuffer, orig_buff, benchedSize);
+        BMK_initChunks(chunkP, nbChunks, srcBuffer, benchedSize, dstBuffer + benchedSize, dstBuffer + benchedSize + compressedSize, dstBuffer + benchedSize + 2*compressedSize);
+        for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+            if (BMK_compressorSelected(algNb)) speed[nbPlacements][nbSpeeds++] = BMK_benchChunks(0, algNb, chunkP, nbChunks, inFileName);
+
+        // Decompression : compressed data on src, blocks on dst
+        memcpy(dstBuffer, orig_buff, benchedSize);
+        BMK_initChunks(chunkP, nbChunks, dstBuffer, benchedSize, srcBuffer + benchedSize, srcBuffer + benchedSize + compressedSize, srcBuffer + benchedSize + 2*compressedSize);
+        BMK_prepareDecompression(chunkP, nbChunks);
+        memset(dstBuffer, 0, benchedSize);     // zeroing decoded area, for CRC checking
+        for (algNb=0; (algNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); algNb++)
+        {
+            if (!BMK_decompressorSelected(algNb)) continue;
+            speed[nbPlacements][nbSpeeds++] = BMK_benchChunks(1, algNb, chunkP, nbChunks, inFileName);
+            if (XXH32(dstBuffer, (unsigned int)benchedSize, 0) != crcOriginal)
+                DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum with %s (src node %i, dst node %i)\n", inFileName, decompressionNames[algNb], src, dst);
+        }
+
+        munmap(srcBuffer, footprint);
+        munmap(dstBuffer, footprint);
+        nbPlacements++;
+    }
+
+    if (nbNodes > 1) syscall(SYS_set_mempolicy, BMK_MPOL_DEFAULT, NULL, 0);
+    sched_setaffinity(0, sizeof(original), &original);
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i blocks of %i KB, thread on node %i (%i cpus), %i node(s)%s\n", inFileName, nbChunks, chunkSize>>10, threadNode,
+            CPU_COUNT(&nodeCpus[threadNode]), nbNodes, !bound ? ", buffers not bound" : !placed ? ", some pages off their node" : "");
+    DISPLAY("%-21.21s :", "(MB/s) src/dst node");
+    for (i=0; i<nbPlacements; i++) DISPLAY("   %2i/%-2i", placements[i] / NUMA_MAX_NODES, placements[i] % NUMA_MAX_NODES);
+    DISPLAY("   remote\n");
+
+    i = 0;
+    for (algNb=0; algNb < NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS; algNb++)
+    {
+        int decode = (algNb >= NB_COMPRESSION_ALGORITHMS);
+        int nb = decode ? algNb - NB_COMPRESSION_ALGORITHMS : algNb;
+        int p;
+        double worst = 0.;
+        if (decode ? (!decompressionTest || !BMK_decompressorSelected(nb)) : (!compressionTest || !BMK_compressorSelected(nb))) continue;
+        DISPLAY("%-21.21s :", decode ? decompressionNames[nb] : compressionNames[nb]);
+        for (p=0; p<nbPlacements; p++)
+        {
+            DISPLAY(" %7.1f", speed[p][i]);
+            if ((local >= 0) && (p != local) && (speed[p][i] / speed[local][i] - 1. < worst)) worst = speed[p][i] / speed[local][i] - 1.;
+        }
+        // Worst placement against all local, the cost of remote memory
+        if ((local >= 0) && (nbPlacements > 1)) DISPLAY(" %+7.1f%%\n", worst * 100.);
+        else DISPLAY(" %8s\n", "-");
+        i++;
+    }
+
+    free(chunkP);
+    return 0;
+}
+#else
+static int BMK_numaBench(char* inFileName, char* orig_buff, size_t benchedSize, U32 crcOriginal, int nbChunks)
+{
+    (void)inFileName; (void)orig_buff; (void)benchedSize; (void)crcOriginal; (void)nbChunks;
+    DISPLAY("NUMA placement is not supported on this platform\n");
+    return 1;
+}
+#endif
+
+
+//*********************************************************
+//  Codec memory footprint
+//*********************************************************
+// With -DMEMSTAT, one untimed call per block counts what the codec allocates
+// (lz4.c, lz4hc.c and kmem_* allocators, see memstat.h) and the state it
+// keeps on the stack; the figures are shown next to the codec throughput.
+static void BMK_memFootprint(int decode, int algNb, struct chunkParameters* chunkP, int nbChunks, char* text, int size)
+{
+#if defined(MEMSTAT)
+    compressor_t compressionFunction = NULL;
+    decompressor_t decompressionFunction = NULL;
+    initializer_t initFunction = NULL;
+    double allocs = 0., bytes = 0.;
+    size_t peak = 0;
+    int chunkNb;
+
+    text[0] = 0;
+    if (nbChunks == 0) return;
+    if (decode ? BMK_selectDecompressor(algNb, &decompressionFunction) : BMK_selectCompressor(algNb, &compressionFunction, &initFunction)) return;
+    if (initFunction!=NULL) ctx = initFunction(chunkP[0].origBuffer);
+    for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+    {
+        memstat_t st;
+        MEMSTAT_reset();
+        BMK_runChunk(compressionFunction, algNb, decompressionFunction, &chunkP[chunkNb]);
+        st = MEMSTAT_get();
+        allocs += (double)st.allocs;
+        bytes += (double)st.bytes;
+        if (st.peak > peak) peak = st.peak;
+    }
+    if (initFunction!=NULL) free(ctx);
+    snprintf(text, size, "  [peak %.1f KB, %.1f alloc %.1f KB /call]", peak / 1024., allocs / nbChunks, bytes / nbChunks / 1024.);
+#else
+    (void)decode; (void)algNb; (void)chunkP; (void)nbChunks; (void)size;
+    text[0] = 0;
+#endif
+}
+
+
+//*********************************************************
+//  Result files and baseline comparison
+//*********************************************************
+// One line per file x block size x codec, tab separated :
+//    file, block size, c|d, codec, best MB/s, mean MB/s, stddev, samples, ratio %
+#define RESULT_HEADER "# fullbench results : file\tblock\tkind\tcodec\tbest_MB/s\tmean_MB/s\tstddev\tsamples\tratio%\n"
+#define RESULT_CONDITIONS "# conditions : "
+#define REGRESSION_EXIT_CODE 20
+#define MAX_BASELINE_FILES 256
+
+struct benchResult
+{
+    char   file[256];
+    int    blockSize;
+    int    decode;
+    char   codec[32];
+    double best;
+    double mean;
+    double stddev;
+    int    samples;
+    double ratio;
+};
+
+struct resultTable
+{
+    struct benchResult* results;
+    int nb;
+    int max;
+};
+
+static struct resultTable currentResults = { NULL, 0, 0 };
+static struct resultTable baselineResults = { NULL, 0, 0 };
+static char baselineConditions[256] = "unknown";
+static struct hostFingerprint baselineFingerprint = { "unknown", "unknown", "unknown" };
+
+static void BMK_sizeLabel(char* label, int size)
+{
+    if ((size >= (1<<20)) && !(size & ((1<<20)-1))) sprintf(label, "%iM", size>>20);
+    else if ((size >= 1024) && !(size & 1023)) sprintf(label, "%iK", size>>10);
+    else sprintf(label, "%i", size);
+}
+
+static int BMK_addResult(struct resultTable* table, const struct benchResult* result)
+{
+    if (table->nb == table->max)
+    {
+        int max = table->max ? table->max * 2 : 64;
+        struct benchResult* results = (struct benchResult*) realloc(table->results, max * sizeof(struct benchResult));
+        if (results==NULL) return 1;
+        table->results = results;
+        table->max = max;
+    }
+    table->results[table->nb++] = *result;
+    return 0;
+}
+
+static void BMK_recordResult(char* inFileName, int decode, char* codec, double bestTime, double speedSum, double speedSquares, size_t benchedSize, double ratio)
+{
+    // Keeps one cell of the standard benchmark, when results are saved or compared
+    struct benchResult r;
+    int n = nbIterations;
+
+    if ((resultFileName==NULL) && (baselineFileName==NULL)) return;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.file, sizeof(r.file), "%s", inFileName);
+    snprintf(r.codec, sizeof(r.codec), "%s", codec);
+    r.blockSize = chunkSize;
+    r.decode = decode;
+    r.best = (double)benchedSize / bestTime / 1000.;
+    r.mean = speedSum / n;
+    r.stddev = (n > 1) ? sqrt(fmax(speedSquares - speedSum * speedSum / n, 0.) / (n - 1)) : 0.;
+    r.samples = n;
+    r.ratio = ratio;
+    if (BMK_addResult(&currentResults, &r)) DISPLAY("\nError: not enough memory to keep results!\n");
+}
+
+static int BMK_saveResults(char* fileName)
+{
+    FILE* f = fopen(fileName, "w");
+    int i;
+
+    char text[256];
+
+    if (f==NULL) { DISPLAY("Error: can not create %s\n", fileName); return 14; }
+    fputs(RESULT_HEADER, f);
+    BMK_endConditions();
+    BMK_describeConditions(text, sizeof(text));
+    fprintf(f, "%s%s\n", RESULT_CONDITIONS, text);
+    fprintf(f, "%s%s\n", RESULT_CPU, fingerprint.cpu);
+    fprintf(f, "%s%s\n", RESULT_HOST, fingerprint.host);
+    fprintf(f, "%s%s\n", RESULT_BUILD, fingerprint.build);
+    for (i=0; i<currentResults.nb; i++)
+    {
+        struct benchResult* r = &currentResults.results[i];
+        fprintf(f, "%s\t%i\t%c\t%s\t%.2f\t%.2f\t%.3f\t%i\t%.3f\n", r->file, r->blockSize, r->decode ? 'd' : 'c', r->codec, r->best, r->mean, r->stddev, r->samples, r->ratio);
+    }
+    fclose(f);
+    DISPLAY("%i results saved to %s\n", currentResults.nb, fileName);
+    return 0;
+}
+
+static void BMK_loadFingerprint(const char* line, const char* prefix, char* value, int size)
+{
+    size_t length;
+    if (strncmp(line, prefix, strlen(prefix))) return;
+    line += strlen(prefix);
+    length = strcspn(line, "\r\n");
+    if (length >= (size_t)size) length = size - 1;
+    memcpy(value, line, length);
+    value[length] = 0;
+}
+
+static int BMK_loadResults(char* fileName, struct resultTable* table)
+{
+    FILE* f = fopen(fileName, "r");
+    char line[1024];
+    int lineNb = 0;
+
+    if (f==NULL) { DISPLAY("Error: can not open baseline %s\n", fileName); return 11; }
+    while (fgets(line, sizeof(line), f))
+    {
+        struct benchResult r;
+        char kind;
+        lineNb++;
+        if (!strncmp(line, RESULT_CONDITIONS, strlen(RESULT_CONDITIONS)))
+        {
+            snprintf(baselineConditions, sizeof(baselineConditions), "%.250s", line + strlen(RESULT_CONDITIONS));
+            baselineConditions[strcspn(baselineConditions, "\r\n")] = 0;
+        }
+        BMK_loadFingerprint(line, RESULT_CPU, baselineFingerprint.cpu, sizeof(baselineFingerprint.cpu));
+        BMK_loadFingerprint(line, RESULT_HOST, baselineFingerprint.host, sizeof(baselineFingerprint.host));
+        BMK_loadFingerprint(line, RESULT_BUILD, baselineFingerprint.build, sizeof(baselineFingerprint.build));
+        if ((line[0]=='#') || (line[0]=='\n') || (line[0]=='\r')) continue;
+        memset(&r, 0, sizeof(r));
+        if (sscanf(line, "%255[^\t]\t%i\t%c\t%31[^\t]\t%lf\t%lf\t%lf\t%i\t%lf", r.file, &r.blockSize, &kind, r.codec, &r.best, &r.mean, &r.stddev, &r.samples, &r.ratio) != 9)
+        {
+            DISPLAY("Error: %s line %i is not a result line\n", fileName, lineNb);
+            fclose(f);
+            return 13;
+        }
+        r.decode = (kind == 'd');
+        if (BMK_addResult(table, &r)) { fclose(f); return 12; }
+    }
+    fclose(f);
+    DISPLAY("- baseline %s : %i results -\n", fileName, table->nb);
+    return 0;
+}
+
+static int BMK_baselineMatrix(char** fileNames, int maxFiles)
+{
+    // Files, block sizes and codecs of the baseline, used when none are given
+    int i, j, nbFiles = 0;
+    int selectAll = (compressionAlgo == ALL_COMPRESSORS) && (decompressionAlgo == ALL_DECOMPRESSORS) && compressionTest && decompressionTest;
+    int setBlockSizes = (nbBlockSizes == 0);
+
+    if (selectAll) { compressionTest = 0; decompressionTest = 0; }
+    for (i=0; i<baselineResults.nb; i++)
+    {
+        struct benchResult* r = &baselineResults.results[i];
+        for (j=0; (j<nbFiles) && strcmp(fileNames[j], r->file); j++);
+        if ((j == nbFiles) && (nbFiles < maxFiles))
+        {
+            if (BMK_GetFileSize(r->file) == 0) DISPLAY("WARNING: baseline file '%s' can not be read, skipped\n", r->file);
+            else fileNames[nbFiles++] = r->file;
+        }
+        if (setBlockSizes)
+        {
+            for (j=0; (j<nbBlockSizes) && (blockSizes[j] != r->blockSize); j++);
+            if (j == nbBlockSizes) BMK_SetBlocksize(r->blockSize);
+        }
+        if (selectAll)
+        {
+            int algNb = r->decode ? BMK_findCodec(r->codec, decompressionNames, NB_DECOMPRESSION_ALGORITHMS)
+                                  : BMK_findCodec(r->codec, compressionNames, NB_COMPRESSION_ALGORITHMS);
+            if (algNb < 0) { DISPLAY("WARNING: baseline codec '%s' is unknown, skipped\n", r->codec); continue; }
+            if (r->decode) { decompressionTest = 1; decompressionAlgo |= 1 << algNb; }
+            else { compressionTest = 1; compressionAlgo |= 1 << algNb; }
+        }
+    }
+    return nbFiles;
+}
+
+static int BMK_compareBaseline(void)
+{
+    // Welch's t-test on the per iteration speeds tells noise from real changes;
+    // a regression is a significant drop of the mean larger than the threshold.
+    int i, j, nbRegressions = 0, nbMissing = 0;
+    char text[256];
+
+    DISPLAY("\n ** baseline comparison : %s, regression threshold %.1f%% ** \n", baselineFileName, regressionThreshold);
+    BMK_endConditions();
+    BMK_describeConditions(text, sizeof(text));
+    DISPLAY("baseline conditions : %s\n", baselineConditions);
+    DISPLAY("current conditions  : %s\n", text);
+    // A different host or build explains a difference better than the code does
+    if (strcmp(baselineFingerprint.cpu, fingerprint.cpu)) DISPLAY("WARNING: baseline cpu differs : %s\n", baselineFingerprint.cpu);
+    if (strcmp(baselineFingerprint.host, fingerprint.host)) DISPLAY("WARNING: baseline host differs : %s\n", baselineFingerprint.host);
+    if (strcmp(baselineFingerprint.build, fingerprint.build)) DISPLAY("WARNING: baseline build differs : %s\n", baselineFingerprint.build);
+    DISPLAY("%-20.20s %6s %-23.23s %9s %9s %8s %7s\n", "file", "block", "codec", "baseline", "current", "delta", "t");
+    for (i=0; i<currentResults.nb; i++)
+    {
+        struct benchResult* c = &currentResults.results[i];
+        struct benchResult* b = NULL;
+        char label[16];
+        double delta, se, t;
+        int significant, regression;
+
+        for (j=0; j<baselineResults.nb; j++)
+        {
+            struct benchResult* r = &baselineResults.results[j];
+            if ((r->blockSize == c->blockSize) && (r->decode == c->decode) && !strcmp(r->codec, c->codec) && !strcmp(r->file, c->file)) { b = r; break; }
+        }
+        BMK_sizeLabel(label, c->blockSize);
+        if (b == NULL)
+        {
+            DISPLAY("%-20.20s %6s %-23.23s %9s %9.1f  (not in baseline)\n", c->file, label, c->codec, "-", c->mean);
+            nbMissing++;
+            continue;
+        }
+
+        delta = (c->mean / b->mean - 1.) * 100.;
+        se = sqrt(c->stddev * c->stddev / c->samples + b->stddev * b->stddev / b->samples);
+        if (se > 0.)
+        {
+            // Welch-Satterthwaite degrees of freedom
+            double vc = c->stddev * c->stddev / c->samples, vb = b->stddev * b->stddev / b->samples;
+            double df = (vc + vb) * (vc + vb) / ((c->samples > 1 ? vc * vc / (c->samples - 1) : 0.) + (b->samples > 1 ? vb * vb / (b->samples - 1) : 0.) + 1e-300);
+            t = (c->mean - b->mean) / se;
+            significant = fabs(t) > BMK_tValue95((int)df);
+        }
+        else
+        {
+            t = 0.;
+            significant = (c->mean != b->mean);
+        }
+        regression = significant && (delta < -regressionThreshold);
+        nbRegressions += regression;
+
+        DISPLAY("%-20.20s %6s %-23.23s %9.1f %9.1f %+7.1f%% %7.2f %s%s\n", c->file, label, c->codec, b->mean, c->mean, delta, t,
+                significant ? "*" : " ", regression ? " REGRESSION" : "");
+    }
+    DISPLAY("* : significant at 95%%.  %i regression(s)", nbRegressions);
+    if (nbMissing) DISPLAY(", %i result(s) not in baseline", nbMissing);
+    DISPLAY("\n");
+    return nbRegressions;
+}
+
+
+//*********************************************************
+//  Ratio vs throughput Pareto report
+//*********************************************************
+// Every compressor x decompressor pair of a format, at every block size, is
+// a point : ratio, compress MB/s and decode MB/s of that compressor's output
+// (measured like -M). Within a file, a point is on the frontier when no other
+// point is at least as good on all three and better on one. Files are then
+// grouped into classes by the best ratio reached, and each class lists the
+// options on its frontiers, with the number of files where they are.
+#define PARETO_COMPRESSIBLE     50.     // best ratio below : 'compressible'
+#define PARETO_INCOMPRESSIBLE   85.     // best ratio above : 'incompressible'
+#define PARETO_NB_CLASSES       3
+static const char* paretoClassNames[PARETO_NB_CLASSES] = { "compressible", "moderate", "incompressible" };
+
+struct paretoPoint
+{
+    char   file[256];
+    int    blockSize;
+    int    cAlgNb;
+    int    dAlgNb;
+    double ratio;
+    double cSpeed;
+    double dSpeed;
+    int    frontier;
+};
+
+static struct paretoPoint* paretoPoints = NULL;
+static int nbParetoPoints = 0;
+static int maxParetoPoints = 0;
+
+static int BMK_paretoBench(char* inFileName, char* orig_buff, size_t benchedSize, int nbChunks)
+{
+    double speed[NB_COMPRESSION_ALGORITHMS][NB_DECOMPRESSION_ALGORITHMS];
+    double ratio[NB_COMPRESSION_ALGORITHMS];
+    double cSpeed[NB_COMPRESSION_ALGORITHMS];
+    int nbStored[NB_COMPRESSION_ALGORITHMS];
+    int cAlgNb, dAlgNb;
+    int nbFailures = BMK_matrixMeasure(inFileName, orig_buff, benchedSize, nbChunks, speed, ratio, nbStored, cSpeed, 1);
+
+    if (nbFailures == MATRIX_NO_MEMORY) return 12;
+    if (nbFailures < 0) return 1;
+
+    DISPLAY("\r%79s\r", "");
+    for (cAlgNb=0; cAlgNb<NB_COMPRESSION_ALGORITHMS; cAlgNb++)
+    for (dAlgNb=0; dAlgNb<NB_DECOMPRESSION_ALGORITHMS; dAlgNb++)
+    {
+        struct paretoPoint* p;
+        if (!BMK_compressorSelected(cAlgNb) || (speed[cAlgNb][dAlgNb] <= 0.)) continue;
+        if (nbParetoPoints == maxParetoPoints)
+        {
+            int max = maxParetoPoints ? maxParetoPoints * 2 : 64;
+            struct paretoPoint* points = (struct paretoPoint*) realloc(paretoPoints, max * sizeof(struct paretoPoint));
+            if (points==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+            paretoPoints = points;
+            maxParetoPoints = max;
+        }
+        p = &paretoPoints[nbParetoPoints++];
+        snprintf(p->file, sizeof(p->file), "%s", inFileName);
+        p->blockSize = chunkSize;
+        p->cAlgNb = cAlgNb;
+        p->dAlgNb = dAlgNb;
+        p->ratio = ratio[cAlgNb];
+        p->cSpeed = cSpeed[cAlgNb];
+        p->dSpeed = speed[cAlgNb][dAlgNb];
+        p->frontier = 0;
+        DISPLAY("%-21.21s > %-21.21s %5iK : %6.2f%% %8.1f MB/s %8.1f MB/s\n", compressionNames[cAlgNb], decompressionNames[dAlgNb],
+                chunkSize>>10, p->ratio, p->cSpeed, p->dSpeed);
+    }
+    return nbFailures ? 15 : 0;
+}
+
+static int BMK_paretoDominates(const struct paretoPoint* a, const struct paretoPoint* b)
+{
+    if ((a->ratio > b->ratio) || (a->cSpeed < b->cSpeed) || (a->dSpeed < b->dSpeed)) return 0;
+    return (a->ratio < b->ratio) || (a->cSpeed > b->cSpeed) || (a->dSpeed > b->dSpeed);
+}
+
+static int BMK_paretoClass(const char* file)
+{
+    double best = 100.;
+    int i;
+    for (i=0; i<nbParetoPoints; i++) if (!strcmp(paretoPoints[i].file, file) && (paretoPoints[i].ratio < best)) best = paretoPoints[i].ratio;
+    if (best < PARETO_COMPRESSIBLE) return 0;
+    if (best < PARETO_INCOMPRESSIBLE) return 1;
+    return 2;
+}
+
+static int BMK_paretoReport(char* fileName)
+{
+    FILE* f;
+    int i, j, cls, nbFiles = 0;
+    char label[16];
+
+    if (nbParetoPoints == 0) { DISPLAY("Error: no Pareto point measured\n"); return 1; }
+    for (i=0; i<nbParetoPoints; i++)
+    {
+        paretoPoints[i].frontier = 1;
+        for (j=0; (j<nbParetoPoints) && paretoPoints[i].frontier; j++)
+            if (!strcmp(paretoPoints[i].file, paretoPoints[j].file) && BMK_paretoDominates(&paretoPoints[j], &paretoPoints[i])) paretoPoints[i].frontier = 0;
+    }
+
+    // gnuplot data : one data set per file, separated by two blank lines (gnuplot 'index')
+    f = fopen(fileName, "w");
+    if (f==NULL) { DISPLAY("Error: can not create %s\n", fileName); return 14; }
+    fprintf(f, "# fullbench Pareto data : one index per file, frontier 1 when no other point of the file dominates\n");
+    fprintf(f, "# gnuplot> plot '%s' index 0 using 2:1 title 'all', '' index 0 using ($7 ? $2 : 1/0):1 title 'frontier'\n", fileName);
+    fprintf(f, "%s%s\n", RESULT_CPU, fingerprint.cpu);
+    fprintf(f, "%s%s\n", RESULT_BUILD, fingerprint.build);
+    for (i=0; i<nbParetoPoints; i++)
+    {
+        // The points of a file are contiguous, all its block sizes included
+        struct paretoPoint* p = &paretoPoints[i];
+        if ((i == 0) || strcmp(paretoPoints[i-1].file, p->file))
+        {
+            if (nbFiles++) fprintf(f, "\n\n");
+            fprintf(f, "# index %i : %s (%s)\n", nbFiles-1, p->file, paretoClassNames[BMK_paretoClass(p->file)]);
+            fprintf(f, "# ratio%%\tcompress_MB/s\tdecompress_MB/s\tblock\tcompressor\tdecompressor\tfrontier\n");
+        }
+        fprintf(f, "%.3f\t%.1f\t%.1f\t%i\t\"%s\"\t\"%s\"\t%i\n", p->ratio, p->cSpeed, p->dSpeed, p->blockSize,
+                compressionNames[p->cAlgNb], decompressionNames[p->dAlgNb], p->frontier);
+    }
+    fclose(f);
+    DISPLAY("%i points of %i file(s) saved to %s\n", nbParetoPoints, nbFiles, fileName);
+
+    // Text summary : per class, the options on the frontier of the most files
+    for (cls=0; cls<PARETO_NB_CLASSES; cls++)
+    {
+        int nbClassFiles = 0, header = 0;
+        for (i=0; i<nbParetoPoints; i++)
+            if (((i == 0) || strcmp(paretoPoints[i-1].file, paretoPoints[i].file)) && (BMK_paretoClass(paretoPoints[i].file) == cls)) nbClassFiles++;
+        if (nbClassFiles == 0) continue;
+
+        for (i=0; i<nbParetoPoints; i++)
+        {
+            struct paretoPoint* p = &paretoPoints[i];
+            double ratioSum = 0., cSum = 0., dSum = 0.;
+            int count = 0;
+            if (!p->frontier || (BMK_paretoClass(p->file) != cls)) continue;
+            // Count each option once, at its first frontier point in the class
+            for (j=0; j<i; j++)
+            {
+                struct paretoPoint* q = &paretoPoints[j];
+                if (q->frontier && (q->cAlgNb == p->cAlgNb) && (q->dAlgNb == p->dAlgNb) && (q->blockSize == p->blockSize) && (BMK_paretoClass(q->file) == cls)) break;
+            }
+            if (j < i) continue;
+            for (j=i; j<nbParetoPoints; j++)
+            {
+                struct paretoPoint* q = &paretoPoints[j];
+                if (!q->frontier || (q->cAlgNb != p->cAlgNb) || (q->dAlgNb != p->dAlgNb) || (q->blockSize != p->blockSize) || (BMK_paretoClass(q->file) != cls)) continue;
+                ratioSum += q->ratio; cSum += q->cSpeed; dSum += q->dSpeed;
+                count++;
+            }
+            if (!header)
+            {
+                DISPLAY("\n ** %s data (%i file(s)) : options on the Pareto frontier ** \n", paretoClassNames[cls], nbClassFiles);
+                DISPLAY("%-21.21s   %-21.21s %6s %6s %8s %10s %10s\n", "compressor", "decompressor", "block", "files", "ratio", "comp MB/s", "deco MB/s");
+                header = 1;
+            }
+            BMK_sizeLabel(label, p->blockSize);
+            DISPLAY("%-21.21s > %-21.21s %6s %3i/%-2i %7.2f%% %10.1f %10.1f\n", compressionNames[p->cAlgNb], decompressionNames[p->dAlgNb], label,
+                    count, nbClassFiles, ratioSum / count, cSum / count, dSum / count);
+        }
+    }
+    return 0;
+}
+
+
+static int BMK_standardBench(char* inFileName, struct chunkParameters* chunkP, int nbChunks, char* orig_buff, char* compressed_buff, size_t benchedSize, U32 crcOriginal,
+                             double* cTime, double* cSizes, double* dTime)
+{
+    // Best time (ms per pass) and compressed size of every selected codec
+    int loopNb, nb_loops, chunkNb, cAlgNb, dAlgNb;
+    size_t cSize=0;
+    double ratio=0.;
+    char memText[64];
+
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : \n", inFileName);
+
+    // Compression Algorithms
+    for (cAlgNb=0; (cAlgNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); cAlgNb++)
+    {
+        char* cName = compressionNames[cAlgNb];
+        compressor_t compressionFunction;
+        initializer_t initFunction;
+        double bestTime = 100000000.;
+        double speedSum = 0., speedSquares = 0.;
+
+        if (!BMK_compressorSelected(cAlgNb)) continue;
+
+        if (BMK_selectCompressor(cAlgNb, &compressionFunction, &initFunction)) return 1;
+
+        for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+        {
+            double averageTime;
+            int milliTime;
+
+            DISPLAY("%1i-%-19.19s : %9i ->\r", loopNb, cName, (int)benchedSize);
+            { size_t i; for (i=0; i<benchedSize; i++) compressed_buff[i]=(char)i; }     // warmimg up memory
+
+            nb_loops = 0;
+            milliTime = BMK_GetMilliStart();
+            while(BMK_GetMilliStart() == milliTime);
+            milliTime = BMK_GetMilliStart();
+            while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+            {
+                if (initFunction!=NULL) ctx = initFunction(chunkP[0].origBuffer);
+                for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+                {
+                    chunkP[chunkNb].compressedSize = compressionFunction(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize);
+                    if (chunkP[chunkNb].compressedSize==0) DISPLAY("ERROR ! %s() = 0 !! \n", cName), exit(1);
+                }
+                if (initFunction!=NULL) free(ctx);
+                nb_loops++;
+            }
+            milliTime = BMK_GetMilliSpan(milliTime);
+
+            averageTime = (double)milliTime / nb_loops;
+            if (averageTime < bestTime) bestTime = averageTime;
+            speedSum += (double)benchedSize / averageTime / 1000.;
+            speedSquares += ((double)benchedSize / averageTime / 1000.) * ((double)benchedSize / averageTime / 1000.);
+            cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
+            ratio = (double)cSize/(double)benchedSize*100.;
+            DISPLAY("%1i-%-19.19s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, cName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / bestTime / 1000.);
+        }
+
+        BMK_memFootprint(0, cAlgNb, chunkP, nbChunks, memText, sizeof(memText));
+        if (ratio<100.)
+            DISPLAY("%-21.21s : %9i -> %9i (%5.2f%%),%7.1f MB/s%s\n", cName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / bestTime / 1000., memText);
+        else
+            DISPLAY("%-21.21s : %9i -> %9i (%5.1f%%),%7.1f MB/s%s\n", cName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / bestTime / 1000., memText);
+
+        cTime[cAlgNb] = bestTime;
+        cSizes[cAlgNb] = (double)cSize;
+        BMK_recordResult(inFileName, 0, cName, bestTime, speedSum, speedSquares, benchedSize, ratio);
+    }
+
+    // Prepare layout for decompression
+    BMK_prepareDecompression(chunkP, nbChunks);
+    if (decompressionTest) memset(orig_buff, 0, benchedSize);     // zeroing source area, for CRC checking
+
+    // Decompression Algorithms
+    for (dAlgNb=0; (dAlgNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); dAlgNb++)
+    {
+        char* dName = decompressionNames[dAlgNb];
+        decompressor_t decompressionFunction;
+        double bestTime = 100000000.;
+        double speedSum = 0., speedSquares = 0.;
+
+        if (!BMK_decompressorSelected(dAlgNb)) continue;
+
+        if (BMK_selectDecompressor(dAlgNb, &decompressionFunction)) return 1;
+
+        for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+        {
+            double averageTime;
+            int milliTime;
+            U32 crcDecoded;
+
+            DISPLAY("%1i-%-24.24s :%10i ->\r", loopNb, dName, (int)benchedSize);
+
+            nb_loops = 0;
+            milliTime = BMK_GetMilliStart();
+            while(BMK_GetMilliStart() == milliTime);
+            milliTime = BMK_GetMilliStart();
+            while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+            {
+                for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
+                {
+                    int decodedSize = BMK_decompressChunk(dAlgNb, decompressionFunction, &chunkP[chunkNb]);
+                    if (chunkP[chunkNb].origSize != decodedSize)
+                    {
+                      DISPLAY("ERROR @ Chunk %i ! %s() == %i != %i !! \n", chunkNb, dName, decodedSize, chunkP[chunkNb].origSize);
+                      compareBufferToFile(chunkP[chunkNb].origBuffer, decodedSize, inFileName, chunkNb*chunkSize);
+                      exit(1);
+                    }
+                }
+                nb_loops++;
+            }
+            milliTime = BMK_GetMilliSpan(milliTime);
+
+            averageTime = (double)milliTime / nb_loops;
+            if (averageTime < bestTime) bestTime = averageTime;
+            speedSum += (double)benchedSize / averageTime / 1000.;
+            speedSquares += ((double)benchedSize / averageTime / 1000.) * ((double)benchedSize / averageTime / 1000.);
+
+            DISPLAY("%1i-%-24.24s :%10i -> %7.1f MB/s\r", loopNb, dName, (int)benchedSize, (double)benchedSize / bestTime / 1000.);
+
+            // CRC Checking
+            crcDecoded = XXH32(orig_buff, (int)benchedSize, 0);
+            if (crcOriginal!=crcDecoded) {
+                DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOriginal, (unsigned)crcDecoded);
+                /*WARNINGS, shouldn't exit. exit(1);*/
+                compareBufferToFile(orig_buff, benchedSize, inFileName, 0);
+            }
+        }
+
+        BMK_memFootprint(1, dAlgNb, chunkP, nbChunks, memText, sizeof(memText));
+        DISPLAY("%-26.26s :%10i -> %7.1f MB/s%s\n", dName, (int)benchedSize, (double)benchedSize / bestTime / 1000., memText);
+
+        dTime[dAlgNb] = bestTime;
+        BMK_recordResult(inFileName, 1, dName, bestTime, speedSum, speedSquares, benchedSize, 0.);
+    }
+
+
+    return 0;
+}
+
+
+static void BMK_displaySweep(double size, double cTime[][NB_COMPRESSION_ALGORITHMS], double cSizes[][NB_COMPRESSION_ALGORITHMS], double dTime[][NB_DECOMPRESSION_ALGORITHMS])
+{
+    // One line per codec, one column per block size
+    int algNb, sizeNb;
+
+    DISPLAY("%-23.23s :", "(MB/s)");
+    for (sizeNb=0; sizeNb<nbBlockSizes; sizeNb++) { char label[16]; BMK_sizeLabel(label, blockSizes[sizeNb]); DISPLAY(" %8s", label); }
+    DISPLAY("\n");
+    for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+    {
+        if (!BMK_compressorSelected(algNb)) continue;
+        DISPLAY("%-23.23s :", compressionNames[algNb]);
+        for (sizeNb=0; sizeNb<nbBlockSizes; sizeNb++) DISPLAY(" %8.1f", size / cTime[sizeNb][algNb] / 1000.);
+        DISPLAY("\n");
+    }
+    for (algNb=0; (algNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); algNb++)
+    {
+        if (!BMK_decompressorSelected(algNb)) continue;
+        DISPLAY("%-23.23s :", decompressionNames[algNb]);
+        for (sizeNb=0; sizeNb<nbBlockSizes; sizeNb++) DISPLAY(" %8.1f", size / dTime[sizeNb][algNb] / 1000.);
+        DISPLAY("\n");
+    }
+    for (algNb=0; (algNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); algNb++)
+    {
+        char label[32];
+        if (!BMK_compressorSelected(algNb)) continue;
+        sprintf(label, "%.17s ratio%%", compressionNames[algNb]);
+        DISPLAY("%-23.23s :", label);
+        for (sizeNb=0; sizeNb<nbBlockSizes; sizeNb++) DISPLAY(" %8.2f", cSizes[sizeNb][algNb] / size * 100.);
+        DISPLAY("\n");
+    }
+}
+
+
+static int BMK_benchBuffer(char* inFileName, char* orig_buff, size_t benchedSize, U32 crcOriginal,
+                           double fileCTime[][NB_COMPRESSION_ALGORITHMS], double fileCSize[][NB_COMPRESSION_ALGORITHMS], double fileDTime[][NB_DECOMPRESSION_ALGORITHMS])
+{
+    // Standard mode results are added to the file* tables, one line per block size
+    int sizeNb;
+
+    // A trace sets its own operation sizes : replayed once, whatever the block sizes
+    if (benchMode == MODE_TRACE) return BMK_traceReplay(inFileName, orig_buff, benchedSize);
+
+    // Loop for each block size, the buffer is only loaded once
+    for (sizeNb=0; sizeNb<nbBlockSizes; sizeNb++)
+    {
+        int nbChunks;
+        int maxCompressedChunkSize;
+        struct chunkParameters* chunkP;
+        char* compressed_buff; size_t compressedBuffSize;
+        char* compressed_LZJBbuff; size_t compressedLZJBBuffSize;
+        char* compressed_ZFSLZ4buff; size_t compressedZFSLZ4BuffSize;
+        int result = 0;
+
+        chunkSize = blockSizes[sizeNb];
+        if (XXH32(orig_buff, (unsigned int)benchedSize, 0) != crcOriginal)
+        {
+          DISPLAY("\nError: '%s' was corrupted by a previous block size, stopping.\n", inFileName);
+          return 13;
+        }
+
+        // Alloc
+        nbChunks = (int) (benchedSize / chunkSize);
+        if ((size_t)chunkSize * nbChunks < benchedSize) nbChunks++; /* Handle odd sized end chunks, and chunk aligned data */
+        chunkP = (struct chunkParameters*) malloc(nbChunks * sizeof(struct chunkParameters));
+        maxCompressedChunkSize = LZ4_compressBound(chunkSize);
+        compressedBuffSize = (size_t)nbChunks * maxCompressedChunkSize;
+        compressed_buff = BMK_allocBuffer(compressedBuffSize, pageMode);
+        compressedLZJBBuffSize = (size_t)nbChunks * maxCompressedChunkSize;
+        compressed_LZJBbuff = BMK_allocBuffer(compressedLZJBBuffSize, pageMode);
+        compressedZFSLZ4BuffSize = (size_t)nbChunks * maxCompressedChunkSize;
+        compressed_ZFSLZ4buff = BMK_allocBuffer(compressedZFSLZ4BuffSize, pageMode);
+
+        if(!chunkP || !compressed_buff || !compressed_LZJBbuff || !compressed_ZFSLZ4buff)
+        {
+          DISPLAY("\nError: not enough memory!\n");
+          BMK_freeBuffer(compressed_buff, compressedBuffSize, pageMode);
+          BMK_freeBuffer(compressed_LZJBbuff, compressedLZJBBuffSize, pageMode);
+          BMK_freeBuffer(compressed_ZFSLZ4buff, compressedZFSLZ4BuffSize, pageMode);
+          free(chunkP);
+          return 12;
+        }
+
+        // Init chunks data
+        BMK_initChunks(chunkP, nbChunks, orig_buff, benchedSize, compressed_buff, compressed_LZJBbuff, compressed_ZFSLZ4buff);
+        if (nbBlockSizes > 1) DISPLAY("-Block Size of %i %s-\n", (chunkSize >= 1024) ? chunkSize>>10 : chunkSize, (chunkSize >= 1024) ? "KB" : "Bytes");
+
+        if (benchMode == MODE_CACHE) result = BMK_cacheBench(inFileName, chunkP, nbChunks, orig_buff, benchedSize, crcOriginal);
+        if (benchMode == MODE_WORKINGSET) result = BMK_workingSetSweep(inFileName, orig_buff, benchedSize);
+        if (benchMode == MODE_STATS) result = BMK_statBench(inFileName, chunkP, nbChunks, orig_buff, benchedSize, crcOriginal);
+        if (benchMode == MODE_THREADS) result = BMK_threadBench(inFileName, orig_buff, benchedSize, nbChunks);
+        if (benchMode == MODE_MIXED) result = BMK_mixedBench(inFileName, orig_buff, benchedSize, nbChunks);
+        if (benchMode == MODE_ANTAGONIST) result = BMK_antagonistBench(inFileName, chunkP, nbChunks, orig_buff, benchedSize, crcOriginal);
+        if (benchMode == MODE_ZFS) result = BMK_zfsBench(inFileName, chunkP, nbChunks);
+        if (benchMode == MODE_ALIGN) result = BMK_alignBench(inFileName, orig_buff, benchedSize, nbChunks);
+        if (benchMode == MODE_MATRIX) result = BMK_matrixBench(inFileName, orig_buff, benchedSize, nbChunks);
+        if (benchMode == MODE_PARETO) result = BMK_paretoBench(inFileName, orig_buff, benchedSize, nbChunks);
+        if (benchMode == MODE_PAGES) result = BMK_pagesBench(inFileName, orig_buff, benchedSize, crcOriginal, nbChunks);
+        if (benchMode == MODE_NUMA) result = BMK_numaBench(inFileName, orig_buff, benchedSize, crcOriginal, nbChunks);
+        if (benchMode == MODE_STANDARD)
+        {
+            int algNb;
+            double cTime[NB_COMPRESSION_ALGORITHMS] = {0};
+            double cSizes[NB_COMPRESSION_ALGORITHMS] = {0};
+            double dTime[NB_DECOMPRESSION_ALGORITHMS] = {0};
+            result = BMK_standardBench(inFileName, chunkP, nbChunks, orig_buff, compressed_buff, benchedSize, crcOriginal, cTime, cSizes, dTime);
+            for (algNb=0; algNb<NB_COMPRESSION_ALGORITHMS; algNb++)
+            {
+                fileCTime[sizeNb][algNb] += cTime[algNb];
+                fileCSize[sizeNb][algNb] += cSizes[algNb];
+            }
+            for (algNb=0; algNb<NB_DECOMPRESSION_ALGORITHMS; algNb++)
+                fileDTime[sizeNb][algNb] += dTime[algNb];
+        }
+
+        BMK_freeBuffer(compressed_buff, compressedBuffSize, pageMode);
+        BMK_freeBuffer(compressed_LZJBbuff, compressedLZJBBuffSize, pageMode);
+        BMK_freeBuffer(compressed_ZFSLZ4buff, compressedZFSLZ4BuffSize, pageMode);
+        free(chunkP);
+        if (result) return result;
+    }
+
+    return 0;
+}
+
+
+//*********************************************************
+//  Memory mapped input
+//*********************************************************
+#if !defined(BMK_NO_MMAP)
+
+static size_t BMK_mapWindowSize(U64 inFileSize)
+{
+    // A quarter of the RAM : the window gets private copies of its pages once decoded into,
+    // and the two compressed buffers need about as much again
+    U64 windowSize = MAX_MEM;
+#if defined(_SC_PHYS_PAGES)
+    long nbPages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if ((nbPages > 0) && (pageSize > 0) && ((U64)nbPages * pageSize / 4 < windowSize)) windowSize = (U64)nbPages * pageSize / 4;
+#endif
+    windowSize &= ~(U64)((1<<20)-1);     // Window offsets must stay page aligned
+    if (windowSize < (1<<20)) windowSize = 1<<20;
+    if (windowSize > inFileSize) windowSize = inFileSize;
+    return (size_t)windowSize;
+}
+
+
+static void BMK_readAhead(int fd, U64 offset, U64 size)
+{
+#if defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fd, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+#else
+    (void)fd; (void)offset; (void)size;
+#endif
+}
+
+
+static char* BMK_mapWindow(int fd, U64 offset, size_t size)
+{
+    // Private mapping : decoders write into the window, never into the file
+    int flags = MAP_PRIVATE;
+    void* window;
+#if defined(MAP_POPULATE)
+    if (mapInput == MAP_INPUT_POPULATE) flags |= MAP_POPULATE;
+#endif
+    window = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, (off_t)offset);
+    if (window == MAP_FAILED) return NULL;
+    if (mapInput != MAP_INPUT_POPULATE) madvise(window, size, MADV_WILLNEED);
+    return (char*)window;
+}
+
+
+static int BMK_benchMappedFile(char* inFileName, U64 inFileSize,
+                               double fileCTime[][NB_COMPRESSION_ALGORITHMS], double fileCSize[][NB_COMPRESSION_ALGORITHMS], double fileDTime[][NB_DECOMPRESSION_ALGORITHMS])
+{
+    int fd;
+    size_t windowSize;
+    U64 nbWindows, windowNb;
+
+    if (inFileSize == 0)
+    {
+        DISPLAY("\nError: can not map '%s' (empty or not a regular file)\n", inFileName);
+        return 13;
+    }
+    fd = open(inFileName, O_RDONLY);
+    if (fd < 0)
+    {
+        DISPLAY( "Problem opening %s\n", inFileName);
+        return 11;
+    }
+
+    windowSize = BMK_mapWindowSize(inFileSize);
+    nbWindows = (inFileSize + windowSize - 1) / windowSize;
+    if (nbWindows > 1)
+        DISPLAY("'%s' (%llu MB) is benchmarked in %llu windows of %i MB\n", inFileName, (long long unsigned int)(inFileSize>>20), (long long unsigned int)nbWindows, (int)(windowSize>>20));
+    BMK_readAhead(fd, 0, windowSize);
+
+    for (windowNb=0; windowNb<nbWindows; windowNb++)
+    {
+        U64 offset = windowNb * windowSize;
+        size_t benchedSize = (inFileSize - offset < windowSize) ? (size_t)(inFileSize - offset) : windowSize;
+        char windowName[512];
+        char* window;
+        U32 crcOriginal;
+        int result;
+
+        DISPLAY("Mapping %s...       \r", inFileName);
+        window = BMK_mapWindow(fd, offset, benchedSize);
+        if (window == NULL)
+        {
+            DISPLAY("\nError: problem mapping file '%s' !!    \n", inFileName);
+            close(fd);
+            return 13;
+        }
+        if (windowNb+1 < nbWindows) BMK_readAhead(fd, offset + windowSize, windowSize);     // Next window is read while this one is benchmarked
+
+        if (nbWindows > 1) snprintf(windowName, sizeof(windowName), "%s @%lluM", inFileName, (long long unsigned int)(offset>>20));
+        else snprintf(windowName, sizeof(windowName), "%s", inFileName);
+
+        crcOriginal = XXH32(window, (unsigned int)benchedSize, 0);
+        result = BMK_benchBuffer(windowName, window, benchedSize, crcOriginal, fileCTime, fileCSize, fileDTime);
+        munmap(window, benchedSize);
+        if (result) { close(fd); return result; }
+    }
+
+    close(fd);
+    return 0;
+}
+
+#endif
+
+
+static int BMK_benchReadFile(char* inFileName, U64 inFileSize, size_t* benchedSizePtr,
+                             double fileCTime[][NB_COMPRESSION_ALGORITHMS], double fileCSize[][NB_COMPRESSION_ALGORITHMS], double fileDTime[][NB_DECOMPRESSION_ALGORITHMS])
+{
+    FILE* inFile;
+    char* orig_buff;
+    size_t benchedSize;
+    size_t readSize;
+    U32 crcOriginal;
+    int result;
+
+    // Check file existence
+    inFile = fopen( inFileName, "rb" );
+    if (inFile==NULL)
+    {
+      DISPLAY( "Problem opening %s\n", inFileName);
+      return 11;
+    }
+
+    // Memory allocation & restrictions
+    benchedSize = (size_t) BMK_findMaxMem(inFileSize) / 2;
+    if ((U64)benchedSize > inFileSize) benchedSize = (size_t)inFileSize;
+    if (benchedSize < inFileSize)
+    {
+        DISPLAY("Not enough memory for '%s' full size; testing %i MB only...\n", inFileName, (int)(benchedSize>>20));
+    }
+
+    // Alloc
+    orig_buff = BMK_allocBuffer(benchedSize, pageMode);
+    if(!orig_buff)
+    {
+      DISPLAY("\nError: not enough memory!\n");
+      fclose(inFile);
+      return 12;
+    }
+
+    // Fill input buffer
+    DISPLAY("Loading %s...       \r", inFileName);
+    readSize = fread(orig_buff, 1, benchedSize, inFile);
+    fclose(inFile);
+
+    if(readSize != benchedSize)
+    {
+      DISPLAY("\nError: problem reading file '%s' !!    \n", inFileName);
+      BMK_freeBuffer(orig_buff, benchedSize, pageMode);
+      return 13;
+    }
+
+    // Calculating input Checksum
+    crcOriginal = XXH32(orig_buff, (unsigned int)benchedSize,0);
+
+    result = BMK_benchBuffer(inFileName, orig_buff, benchedSize, crcOriginal, fileCTime, fileCSize, fileDTime);
+    BMK_freeBuffer(orig_buff, benchedSize, pageMode);
+    *benchedSizePtr = benchedSize;
+    return result;
+}
+
+
+//*********************************************************
+//  Synthetic data
+//*********************************************************
+// Spec : comma separated key=value list, every key optional
+//    size=16M     : amount of data
+//    ratio=50     : target share (%) of literal bytes, which bounds the compression ratio
+//    offset=1-1023, match=3-66, literal=1-16 : distributions
+//    seed=1       : generator seed
+//    save=file    : also write the data to file
+// A distribution is one or more ranges separated by '/', each with an optional weight :
+//    offset=1-8:30/9-1023:70 draws offsets 1 to 8 30% of the time.
+#define SYNTH_MAX_RANGES 8
+
+struct distribution
+{
+    int nbRanges;
+    int low[SYNTH_MAX_RANGES];
+    int high[SYNTH_MAX_RANGES];
+    U32 weight[SYNTH_MAX_RANGES];
+    U32 totalWeight;
+};
+
+static struct
+{
+    U64 size;
+    double ratio;
+    struct distribution offset;
+    struct distribution match;
+    struct distribution literal;
+    U32 seed;
+    char save[256];
+} synthetic;
+
+static int BMK_parseNumber(const char** p, U64* value)
+{
+    const char* start = *p;
+    *value = 0;
+    while ((**p >= '0') && (**p <= '9')) { *value = *value*10 + (**p - '0'); (*p)++; }
+    if ((**p=='K') || (**p=='k')) { *value <<= 10; (*p)++; }
+    else if ((**p=='M') || (**p=='m')) { *value <<= 20; (*p)++; }
+    else if ((**p=='G') || (**p=='g')) { *value <<= 30; (*p)++; }
+    return *p == start;
+}
+
+static int BMK_parseDistribution(const char** p, struct distribution* d, int minValue, int maxValue)
+{
+    d->nbRanges = 0;
+    d->totalWeight = 0;
+    for (;;)
+    {
+        U64 low, high, weight = 1;
+        if (d->nbRanges == SYNTH_MAX_RANGES) return 1;
+        if (BMK_parseNumber(p, &low)) return 1;
+        high = low;
+        if (**p=='-') { (*p)++; if (BMK_parseNumber(p, &high)) return 1; }
+        if (**p==':') { (*p)++; if (BMK_parseNumber(p, &weight)) return 1; }
+        if ((low < (U64)minValue) || (high > (U64)maxValue) || (low > high) || (weight == 0) || (weight > 1000000)) return 1;
+        d->low[d->nbRanges] = (int)low;
+        d->high[d->nbRanges] = (int)high;
+        d->weight[d->nbRanges] = (U32)weight;
+        d->totalWeight += (U32)weight;
+        d->nbRanges++;
+        if (**p!='/') return 0;
+        (*p)++;
+    }
+}
+
+static int BMK_drawDistribution(const struct distribution* d, U32* seed)
+{
+    U32 w = BMK_rand(seed) % d->totalWeight;
+    int r = 0;
+    while (w >= d->weight[r]) { w -= d->weight[r]; r++; }
+    return d->low[r] + (int)(BMK_rand(seed) % (U32)(d->high[r] - d->low[r] + 1));
+}
+
+static double BMK_meanDistribution(const struct distribution* d)
+{
+    double mean = 0.;
+    int r;
+    for (r=0; r<d->nbRanges; r++) mean += (d->low[r] + d->high[r]) / 2. * d->weight[r];
+    return mean / d->totalWeight;
+}
+
+int BMK_SetSynthetic(const char* spec)
+{
+    const char* p = spec;
+    const char* d;
+    U64 value;
+
+    synthetic.size = 16<<20;
+    synthetic.ratio = 0.;
+    synthetic.seed = 1;
+    synthetic.save[0] = 0;
+    d = "1-1023"; BMK_parseDistribution(&d, &synthetic.offset, 1, 1023);
+    d = "3-66";   BMK_parseDistribution(&d, &synthetic.match, 3, 66);
+    d = "1-16";   BMK_parseDistribution(&d, &synthetic.literal, 1, 1<<16);
+
+    while (*p)
+    {
+        if (!strncmp(p, "size=", 5)) { p+=5; if (BMK_parseNumber(&p, &value) || (value == 0)) return 1; synthetic.size = value; }
+        else if (!strncmp(p, "ratio=", 6)) { p+=6; if (BMK_parseNumber(&p, &value) || (value == 0) || (value > 100)) return 1; synthetic.ratio = (double)value / 100.; }
+        else if (!strncmp(p, "seed=", 5)) { p+=5; if (BMK_parseNumber(&p, &value)) return 1; synthetic.seed = (U32)value; }
+        else if (!strncmp(p, "offset=", 7)) { p+=7; if (BMK_parseDistribution(&p, &synthetic.offset, 1, 1023)) return 1; }
+        else if (!strncmp(p, "match=", 6)) { p+=6; if (BMK_parseDistribution(&p, &synthetic.match, 3, 66)) return 1; }
+        else if (!strncmp(p, "literal=", 8)) { p+=8; if (BMK_parseDistribution(&p, &synthetic.literal, 1, 1<<16)) return 1; }
+        else if (!strncmp(p, "save=", 5))
+        {
+            size_t len;
+            p+=5; len = strcspn(p, ",");
+            if ((len == 0) || (len >= sizeof(synthetic.save))) return 1;
+            memcpy(synthetic.save, p, len); synthetic.save[len] = 0;
+            p += len;
+        }
+        else return 1;
+        if (*p==',') p++;
+        else if (*p) return 1;
+    }
+    if (synthetic.size > MAX_MEM) synthetic.size = MAX_MEM;
+    DISPLAY("- synthetic data : %i MB, seed %u -\n", (int)(synthetic.size>>20), synthetic.seed);
+    return 0;
+}
+
+static void BMK_generateSynthetic(char* buffer, size_t size)
+{
+    // Alternates random literal runs and matches, copied byte by byte so that
+    // offsets smaller than the match length produce runs (LZJB_RLE_DECOMPRESS).
+    U32 seed = synthetic.seed;
+    double matchProbability = 1.;
+    size_t pos = 0;
+
+    if (synthetic.ratio > 0.)
+    {
+        // literal share = E[literal] / (E[literal] + p * E[match])
+        double meanLiteral = BMK_meanDistribution(&synthetic.literal);
+        double meanMatch = BMK_meanDistribution(&synthetic.match);
+        matchProbability = (synthetic.ratio < 1.) ? meanLiteral * (1. - synthetic.ratio) / (synthetic.ratio * meanMatch) : 0.;
+        if (matchProbability > 1.)
+        {
+            DISPLAY("WARNING: literal runs too long for a %i%% literal share, use shorter literal=\n", (int)(synthetic.ratio*100));
+            matchProbability = 1.;
+        }
+    }
+
+    while (pos < size)
+    {
+        int literals = BMK_drawDistribution(&synthetic.literal, &seed);
+        while ((literals-- > 0) && (pos < size)) buffer[pos++] = (char)(BMK_rand(&seed) >> 5);
+        if ((double)(BMK_rand(&seed) & 0xFFFF) < matchProbability * 65536.)
+        {
+            int length = BMK_drawDistribution(&synthetic.match, &seed);
+            size_t offset = (size_t)BMK_drawDistribution(&synthetic.offset, &seed);
+            if (offset > pos) continue;
+            while ((length-- > 0) && (pos < size)) { buffer[pos] = buffer[pos - offset]; pos++; }
+        }
+    }
+}
+
+static int BMK_benchSynthetic(char* name, U64* benchedSizePtr,
+                              double fileCTime[][NB_COMPRESSION_ALGORITHMS], double fileCSize[][NB_COMPRESSION_ALGORITHMS], double fileDTime[][NB_DECOMPRESSION_ALGORITHMS])
+{
+    size_t benchedSize = (size_t)synthetic.size;
+    char* orig_buff = BMK_allocBuffer(benchedSize, pageMode);
+    U32 crcOriginal;
+    int result;
+
+    if (orig_buff==NULL) { DISPLAY("\nError: not enough memory!\n"); return 12; }
+    DISPLAY("Generating %s...       \r", name);
+    BMK_generateSynthetic(orig_buff, benchedSize);
+    if (synthetic.save[0])
+    {
+        FILE* f = fopen(synthetic.save, "wb");
+        if ((f==NULL) || (fwrite(orig_buff, 1, benchedSize, f) != benchedSize))
+            DISPLAY("\nError: can not write synthetic data to '%s'\n", synthetic.save);
+        if (f!=NULL) fclose(f);
+    }
+
+    crcOriginal = XXH32(orig_buff, (unsigned int)benchedSize, 0);
+    result = BMK_benchBuffer(name, orig_buff, benchedSize, crcOriginal, fileCTime, fileCSize, fileDTime);
+    BMK_freeBuffer(orig_buff, benchedSize, pageMode);
+    *benchedSizePtr = benchedSize;
+    return result;
+}
+
+
+//*********************************************************
+//  Worst case inputs
+//*********************************************************
+// Hand made streams which drive the decoders through their slowest paths,
+// and the data they decode to for the compressors :
+//    offset1   : matches of the minimum length at offset 1
+//    55/AA     : copymaps alternating 0x55 and 0xAA, a literal between matches
+//    runs3/5/7 : maximum length matches at offsets 3, 5 and 7 (LZJB_RLE_DECOMPRESS)
+//    literals  : incompressible data, no match at all
+// Every record is timed alone; a codec's figure is its worst record, each
+// record keeping its best of WORST_REPEATS calls to leave noise out.
+#define WORST_NB_PATTERNS   4
+#define WORST_NB_RECORDS    8
+#define WORST_REPEATS       16
+#define WORST_RECORD_SIZE   (128<<10)
+#define LZ4_MATCH_MIN       4
+#define LZ4_LAST_LITERALS   12          // the last match starts 12 bytes before the end at least
+
+static char* worstPatternNames[WORST_NB_PATTERNS] = { "offset1", "55/AA", "runs3/5/7", "literals" };
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  include <x86intrin.h>   // __rdtsc
+#  define BMK_HAS_TSC 1
+#endif
+
+static U64 BMK_GetCycles(void)
+{
+    // TSC when available, else nanoseconds (converted in BMK_worstCaseBench())
+#if defined(BMK_HAS_TSC)
+    return __rdtsc();
+#else
+    return BMK_GetNanoTime();
+#endif
+}
 
-            if ((compressionAlgo != ALL_COMPRESSORS) && ((compressionAlgo & (1 << cAlgNb))==0)) continue;
+static double BMK_cyclesPerNano(void)
+{
+    // Rate of BMK_GetCycles(), measured over 20 ms
+    U64 start = BMK_GetNanoTime(), cycles = BMK_GetCycles(), now;
+    while ((now = BMK_GetNanoTime()) - start < 20000000ULL);
+    return (double)(BMK_GetCycles() - cycles) / (double)(now - start);
+}
 
-            switch(cAlgNb)
-            {
-            case 0: compressionFunction = LZ4_compress; break;
-/*          case 1: compressionFunction = local_LZ4_compress_limitedOutput; break;
-            case 2: compressionFunction = local_LZ4_compress_continue; initFunction = LZ4_create; break;
-            case 3: compressionFunction = local_LZ4_compress_limitedOutput_continue; initFunction = LZ4_create; break;
-*/
-            case 1: compressionFunction = LZ4_compressHC; break;
-/*
-            case 5: compressionFunction = local_LZ4_compressHC_limitedOutput; break;
-            case 6: compressionFunction = local_LZ4_compressHC_continue; initFunction = LZ4_createHC; break;
-            case 7: compressionFunction = local_LZ4_compressHC_limitedOutput_continue; initFunction = LZ4_createHC; break;
-*/
-            case 2: compressionFunction = local_LZ4_compress_zfs; initFunction = local_LZ4_compress_zfs_init; break;
-            case 3: compressionFunction = local_LZJB_compress_zfs; break;
-            case 4: compressionFunction = local_LZJB_compress_hack; break;
-            default : DISPLAY("ERROR ! Bad algorithm Id !! \n"); free(chunkP); return 1;
-            }
+void BMK_SetWorstCase()
+{
+    benchMode = MODE_WORST;
+    DISPLAY("- worst case inputs -\n");
+}
 
-            for (loopNb = 1; loopNb <= nbIterations; loopNb++)
+static int BMK_lzjbCraft(BYTE* dst, int dLen, int pattern, U32 seed)
+{
+    // Returns the size of an LZJB stream decoding to dLen bytes
+    BYTE* const start = dst;
+    BYTE* copymap = NULL;
+    int copymask = 1 << 7;
+    int pos = 0, item = 0, group = 0;
+    static const int runOffsets[3] = { 3, 5, 7 };
+
+    while (pos < dLen)
+    {
+        int match, offset = 1, length = LZJB_MATCH_MIN;
+        if ((copymask <<= 1) == (1 << 8))
+        {
+            copymask = 1;
+            copymap = dst;
+            *dst++ = 0;
+            group++;
+        }
+        switch (pattern)
+        {
+        case 0 : match = (pos >= 1); break;
+        case 1 : match = (((group & 1) ? 0xAA : 0x55) & copymask) && (pos >= 1); offset = 1 + (int)(BMK_rand(&seed) % (U32)((pos < 1023) ? pos + (pos==0) : 1023)); break;
+        case 2 : offset = runOffsets[item % 3]; match = (pos >= 7); length = LZJB_MATCH_MAX; break;
+        default: match = 0;
+        }
+        if (length > dLen - pos) length = dLen - pos;
+        if (match && (length >= LZJB_MATCH_MIN))
+        {
+            *copymap |= (BYTE)copymask;
+            *dst++ = (BYTE)(((length - LZJB_MATCH_MIN) << 2) | (offset >> 8));
+            *dst++ = (BYTE)offset;
+            pos += length;
+            item++;
+        }
+        else
+        {
+            *dst++ = (BYTE)(BMK_rand(&seed) >> 11);
+            pos++;
+        }
+    }
+    return (int)(dst - start);
+}
+
+static BYTE* BMK_lz4Length(BYTE* dst, int length)
+{
+    // Extension bytes of a token field holding 15
+    for (length -= 15; length >= 255; length -= 255) *dst++ = 255;
+    *dst++ = (BYTE)length;
+    return dst;
+}
+
+static int BMK_lz4Craft(BYTE* dst, int dLen, int pattern, U32 seed)
+{
+    // Returns the size of an LZ4 block decoding to dLen bytes, same patterns as LZJB
+    BYTE* const start = dst;
+    int pos = 0, item = 0;
+    static const int runOffsets[3] = { 3, 5, 7 };
+
+    for (;;)
+    {
+        int literals, offset = 1, length = LZ4_MATCH_MIN, i;
+        BYTE* token;
+        switch (pattern)
+        {
+        case 0 : literals = (pos == 0); break;
+        case 1 : literals = 1; offset = 1 + (int)(BMK_rand(&seed) % (U32)(pos < 65535 ? pos + 1 : 65535)); break;
+        case 2 : literals = (pos == 0) ? 7 : 0; offset = runOffsets[item % 3]; length = LZJB_MATCH_MAX; break;
+        default: literals = dLen;
+        }
+        if ((pattern == 3) || (dLen - pos - literals - length < LZ4_LAST_LITERALS)) break;
+        token = dst++;
+        *token = (BYTE)(((literals < 15) ? literals : 15) << 4);
+        if (literals >= 15) dst = BMK_lz4Length(dst, literals);
+        for (i=0; i<literals; i++) *dst++ = (BYTE)(BMK_rand(&seed) >> 11);
+        *dst++ = (BYTE)offset;
+        *dst++ = (BYTE)(offset >> 8);
+        *token |= (BYTE)((length - LZ4_MATCH_MIN < 15) ? length - LZ4_MATCH_MIN : 15);
+        if (length - LZ4_MATCH_MIN >= 15) dst = BMK_lz4Length(dst, length - LZ4_MATCH_MIN);
+        pos += literals + length;
+        item++;
+    }
+
+    // Last literals
+    {
+        int literals = dLen - pos, i;
+        *dst++ = (BYTE)(((literals < 15) ? literals : 15) << 4);
+        if (literals >= 15) dst = BMK_lz4Length(dst, literals);
+        for (i=0; i<literals; i++) *dst++ = (BYTE)(BMK_rand(&seed) >> 11);
+    }
+    return (int)(dst - start);
+}
+
+static double BMK_worstRecord(int decode, int algNb, char* in, int inSize, char* out, int recordSize, double* maxTime)
+{
+    // Best of WORST_REPEATS calls, in cycles (or ns), -1 on a decoding error
+    compressor_t compressionFunction = NULL;
+    decompressor_t decompressionFunction = NULL;
+    initializer_t initFunction = NULL;
+    U64 best = (U64)-1;
+    int n;
+
+    if (decode ? BMK_selectDecompressor(algNb, &decompressionFunction) : BMK_selectCompressor(algNb, &compressionFunction, &initFunction)) return -1.;
+    if (initFunction!=NULL) ctx = initFunction(in);
+    for (n=0; n<=WORST_REPEATS; n++)
+    {
+        U64 start, span;
+        int result;
+        start = BMK_GetCycles();
+        result = decode ? decompressionFunction(in, out, inSize, recordSize) : compressionFunction(in, out, inSize);
+        span = BMK_GetCycles() - start;
+        if (decode ? (result != recordSize) : (result == 0)) { best = (U64)-1; break; }
+        if (n == 0) continue;     // warm up
+        if (span < best) best = span;
+        if ((double)span > *maxTime) *maxTime = (double)span;
+    }
+    if (initFunction!=NULL) free(ctx);
+    return (best == (U64)-1) ? -1. : (double)best;
+}
+
+int BMK_worstCaseBench(void)
+{
+    int recordSize = nbBlockSizes ? chunkSize : WORST_RECORD_SIZE;
+    int bound = LZ4_compressBound(recordSize);
+    size_t patternSize = (size_t)WORST_NB_RECORDS * recordSize;
+    char* raw = (char*) malloc(WORST_NB_PATTERNS * patternSize);          // LZJB streams decode to it, compressors read it
+    char* raw4 = (char*) malloc(WORST_NB_PATTERNS * patternSize);         // LZ4 streams decode to it
+    char* lzjb = (char*) malloc((size_t)WORST_NB_PATTERNS * WORST_NB_RECORDS * bound);
+    int lz4Stride = bound + 4;   // a 4 bytes length header makes an LZ4 block a ZFS lz4 stream
+    char* lz4 = (char*) malloc((size_t)WORST_NB_PATTERNS * WORST_NB_RECORDS * lz4Stride);
+    char* out = (char*) malloc(bound);
+    int lzjbSize[WORST_NB_PATTERNS][WORST_NB_RECORDS], lz4Size[WORST_NB_PATTERNS][WORST_NB_RECORDS];
+    double perCycle = 1.;     // reported unit per unit of BMK_GetCycles()
+    double unitsPerUs = BMK_cyclesPerNano() * 1000.;
+    const char* unit = "TSC ticks/byte";
+    int pattern, record, algNb, nbFailures = 0, result = 0;
+
+    if (!raw || !raw4 || !lzjb || !lz4 || !out) { DISPLAY("\nError: not enough memory!\n"); result = 12; goto _cleanup; }
+#if !defined(BMK_HAS_TSC)
+    if (conditions.maxFreq) { perCycle = conditions.maxFreq / 1000000.; unit = "cycles/byte (from max frequency)"; }
+    else unit = "ns/byte";
+#endif
+    chunkSize = recordSize;   // the ZFS wrappers size their output buffer from chunkSize
+
+    // Streams, and the data they decode to with the reference decoders
+    for (pattern=0; pattern<WORST_NB_PATTERNS; pattern++)
+        for (record=0; record<WORST_NB_RECORDS; record++)
+        {
+            U32 seed = (U32)(pattern * WORST_NB_RECORDS + record + 1);
+            char* r = raw + pattern * patternSize + (size_t)record * recordSize;
+            char* r4 = raw4 + pattern * patternSize + (size_t)record * recordSize;
+            char* z = lzjb + ((size_t)pattern * WORST_NB_RECORDS + record) * bound;
+            char* l = lz4 + ((size_t)pattern * WORST_NB_RECORDS + record) * lz4Stride;
+            lzjbSize[pattern][record] = BMK_lzjbCraft((BYTE*)z, recordSize, pattern, seed);
+            lz4Size[pattern][record] = BMK_lz4Craft((BYTE*)l + 4, recordSize, pattern, seed);
+            l[0] = (char)(lz4Size[pattern][record] >> 24); l[1] = (char)(lz4Size[pattern][record] >> 16);   // ZFS lz4 header, big endian
+            l[2] = (char)(lz4Size[pattern][record] >> 8);  l[3] = (char)lz4Size[pattern][record];
+            if ((local_LZJB_decompress_original(z, r, lzjbSize[pattern][record], recordSize) != recordSize)
+             || (LZ4_decompress_safe(l + 4, r4, lz4Size[pattern][record], recordSize) != recordSize))
             {
-                double averageTime;
-                int milliTime;
+                DISPLAY("Error: %s streams do not decode\n", worstPatternNames[pattern]);
+                result = 15;
+                goto _cleanup;
+            }
+        }
 
-                DISPLAY("%1i-%-19.19s : %9i ->\r", loopNb, cName, (int)benchedSize);
-                { size_t i; for (i=0; i<benchedSize; i++) compressed_buff[i]=(char)i; }     // warmimg up memory
+    DISPLAY("\n ** worst case inputs : %i records of %i KB per pattern, %s of the worst record ** \n", WORST_NB_RECORDS, recordSize>>10, unit);
+    DISPLAY("%-21.21s :", "codec");
+    for (pattern=0; pattern<WORST_NB_PATTERNS; pattern++) DISPLAY(" %9s", worstPatternNames[pattern]);
+    DISPLAY(" %9s %9s %9s\n", "worst", "us/record", "max us");
 
-                nb_loops = 0;
-                milliTime = BMK_GetMilliStart();
-                while(BMK_GetMilliStart() == milliTime);
-                milliTime = BMK_GetMilliStart();
-                while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
+    for (algNb=0; algNb < NB_COMPRESSION_ALGORITHMS + NB_DECOMPRESSION_ALGORITHMS; algNb++)
+    {
+        int decode = (algNb >= NB_COMPRESSION_ALGORITHMS);
+        int nb = decode ? algNb - NB_COMPRESSION_ALGORITHMS : algNb;
+        int format = decode ? decompressionFormats[nb] : -1;
+        double worst = 0., maxTime = 0.;
+        if (decode ? (!decompressionTest || !BMK_decompressorSelected(nb)) : (!compressionTest || !BMK_compressorSelected(nb))) continue;
+
+        DISPLAY("%-21.21s :", decode ? decompressionNames[nb] : compressionNames[nb]);
+        for (pattern=0; pattern<WORST_NB_PATTERNS; pattern++)
+        {
+            double patternWorst = 0.;
+            for (record=0; record<WORST_NB_RECORDS; record++)
+            {
+                size_t recordNb = (size_t)pattern * WORST_NB_RECORDS + record;
+                char* r = (decode && (format != FORMAT_LZJB) ? raw4 : raw) + pattern * patternSize + (size_t)record * recordSize;
+                char* in = r;
+                int inSize = recordSize;
+                switch(format)
                 {
-                    if (initFunction!=NULL) ctx = initFunction(chunkP[0].origBuffer);
-                    for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                    {
-                        chunkP[chunkNb].compressedSize = compressionFunction(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize);
-                        if (chunkP[chunkNb].compressedSize==0) DISPLAY("ERROR ! %s() = 0 !! \n", cName), exit(1);
-                    }
-                    if (initFunction!=NULL) free(ctx);
-                    nb_loops++;
+                case FORMAT_LZJB:    in = lzjb + recordNb * bound; inSize = lzjbSize[pattern][record]; break;
+                case FORMAT_ZFS_LZ4: in = lz4 + recordNb * lz4Stride; inSize = lz4Size[pattern][record] + 4; break;
+                case FORMAT_LZ4:     in = lz4 + recordNb * lz4Stride + 4; inSize = lz4Size[pattern][record]; break;
                 }
-                milliTime = BMK_GetMilliSpan(milliTime);
-
-                averageTime = (double)milliTime / nb_loops;
-                if (averageTime < bestTime) bestTime = averageTime;
-                cSize=0; for (chunkNb=0; chunkNb<nbChunks; chunkNb++) cSize += chunkP[chunkNb].compressedSize;
-                ratio = (double)cSize/(double)benchedSize*100.;
-                DISPLAY("%1i-%-19.19s : %9i -> %9i (%5.2f%%),%7.1f MB/s\r", loopNb, cName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / bestTime / 1000.);
+                double t = BMK_worstRecord(decode, nb, in, inSize, out, recordSize, &maxTime);
+                if ((t < 0.) || (decode && memcmp(out, r, recordSize))) { patternWorst = -1.; break; }
+                if (t > patternWorst) patternWorst = t;
             }
+            if (patternWorst < 0.) { DISPLAY(" %9s", "FAILED"); nbFailures++; continue; }
+            DISPLAY(" %9.2f", patternWorst * perCycle / recordSize);
+            if (patternWorst > worst) worst = patternWorst;
+        }
+        DISPLAY(" %9.2f %9.1f %9.1f\n", worst * perCycle / recordSize, worst / unitsPerUs, maxTime / unitsPerUs);
+    }
+    if (nbFailures) { DISPLAY("FAILED : wrong size or wrong data on %i pattern(s)\n", nbFailures); result = 15; }
+
+_cleanup:
+    free(raw);
+    free(raw4);
+    free(lzjb);
+    free(lz4);
+    free(out);
+    return result;
+}
 
-            if (ratio<100.)
-                DISPLAY("%-21.21s : %9i -> %9i (%5.2f%%),%7.1f MB/s\n", cName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / bestTime / 1000.);
-            else
-                DISPLAY("%-21.21s : %9i -> %9i (%5.1f%%),%7.1f MB/s\n", cName, (int)benchedSize, (int)cSize, ratio, (double)benchedSize / bestTime / 1000.);
 
-            totalCTime[cAlgNb] += bestTime;
-            totalCSize[cAlgNb] += cSize;
-        }
+//*********************************************************
+//  ZFS record dump replay
+//*********************************************************
+// Records as written to disk by ZFS, in the dump format of lzjbstat -o :
+//    <lsize LE32> <psize LE32> <zio_compress LE32> <psize bytes of payload>
+// repeated; a zdb extraction can be written the same way. The payloads are
+// decoded as they are, by every selected decoder of their format. The first
+// decoder which decodes every record is the reference, the others must
+// produce the same bytes. Other compressions are counted and skipped.
+#define ZIO_COMPRESS_OFF    2
+#define ZIO_COMPRESS_LZJB   3
+#define ZIO_COMPRESS_LZ4    15
+#define RECORD_HEADER_SIZE  12
+#define RECORD_MAX_SIZE     (16<<20)    // largest ZFS record (recordsize=16M)
+
+struct zfsRecord
+{
+    U32   lsize;
+    U32   psize;
+    U32   compression;
+    char* payload;    // in the dump
+    size_t outputPos; // in the output of the records of its compression
+};
 
-        // Prepare layout for decompression
-        for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-        {
-            chunkP[chunkNb].compressedSize = LZ4_compress(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origSize);
-            if (chunkP[chunkNb].compressedSize==0) DISPLAY("ERROR in chunk (%d) ! %s() = 0 !! \n", chunkNb, compressionNames[0]), exit(1);
+static U32 BMK_readLE32(const BYTE* p)
+{
+    return (U32)p[0] | ((U32)p[1] << 8) | ((U32)p[2] << 16) | ((U32)p[3] << 24);
+}
 
-            /* Original ZFS lzjb is not safe on all data streams, it seems.  use the "Safe" version. */
-            chunkP[chunkNb].compressedLZJBSize = local_LZJB_compress_zfs(chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedLZJBBuffer, chunkP[chunkNb].origSize);
-            if (chunkP[chunkNb].compressedLZJBSize==0) DISPLAY("ERROR in chunk (%d,%d) ! %s() = 0 !! \n", chunkNb, chunkP[chunkNb].origSize, compressionNames[FIRST_LZJB_COMP]), exit(1);
+static int BMK_loadRecords(char* fileName, char** dumpPtr, struct zfsRecord** recordsPtr, int* nbRecordsPtr)
+{
+    // The whole dump stays in memory, records point to their payload in it
+    U64 fileSize = BMK_GetFileSize(fileName);
+    FILE* f = fopen(fileName, "rb");
+    char* dump = (char*) malloc((size_t)fileSize + 1);
+    struct zfsRecord* records = NULL;
+    size_t pos = 0;
+    int nbRecords = 0, maxRecords = 0;
+
+    if ((f==NULL) || (dump==NULL) || (fileSize > MAX_MEM))
+    {
+        DISPLAY("Problem opening %s\n", fileName);
+        if (f!=NULL) fclose(f);
+        free(dump);
+        return 11;
+    }
+    if (fread(dump, 1, (size_t)fileSize, f) != (size_t)fileSize) { DISPLAY("Error: problem reading %s\n", fileName); fclose(f); free(dump); return 13; }
+    fclose(f);
 
+    while (pos + RECORD_HEADER_SIZE <= fileSize)
+    {
+        struct zfsRecord r;
+        r.lsize = BMK_readLE32((BYTE*)dump + pos);
+        r.psize = BMK_readLE32((BYTE*)dump + pos + 4);
+        r.compression = BMK_readLE32((BYTE*)dump + pos + 8);
+        r.payload = dump + pos + RECORD_HEADER_SIZE;
+        r.outputPos = 0;
+        pos += RECORD_HEADER_SIZE;
+        if ((r.lsize > RECORD_MAX_SIZE) || (r.psize > RECORD_MAX_SIZE) || (pos + r.psize > fileSize))
+        {
+            DISPLAY("Error: '%s' is truncated or not a record dump (record %i)\n", fileName, nbRecords);
+            free(records); free(dump);
+            return 13;
         }
-        { size_t i; for (i=0; i<benchedSize; i++) orig_buff[i]=0; }     // zeroing source area, for CRC checking
-
-        // Decompression Algorithms
-        for (dAlgNb=0; (dAlgNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); dAlgNb++)
+        pos += r.psize;
+        if (nbRecords == maxRecords)
         {
-            char* dName = decompressionNames[dAlgNb];
-            int (*decompressionFunction)(const char*, char*, int, int);
-            double bestTime = 100000000.;
+            struct zfsRecord* grown;
+            maxRecords = maxRecords ? maxRecords * 2 : 1024;
+            grown = (struct zfsRecord*) realloc(records, maxRecords * sizeof(struct zfsRecord));
+            if (grown==NULL) { DISPLAY("\nError: not enough memory!\n"); free(records); free(dump); return 12; }
+            records = grown;
+        }
+        records[nbRecords++] = r;
+    }
+    if (pos != fileSize) { DISPLAY("Error: '%s' ends with a partial record header\n", fileName); free(records); free(dump); return 13; }
 
-            if ((decompressionAlgo != ALL_DECOMPRESSORS) && ((decompressionAlgo & (1 << dAlgNb))==0)) continue;
+    *dumpPtr = dump;
+    *recordsPtr = records;
+    *nbRecordsPtr = nbRecords;
+    return 0;
+}
 
-            switch(dAlgNb)
-            {
-            case 0: decompressionFunction = local_LZ4_decompress_fast; break;
-/*
-            case 1: decompressionFunction = local_LZ4_decompress_fast_withPrefix64k; break;
-            case 2: decompressionFunction = LZ4_decompress_safe; break;
-            case 3: decompressionFunction = LZ4_decompress_safe_withPrefix64k; break;
-            case 4: decompressionFunction = local_LZ4_decompress_safe_partial; break;
-*/
-            /* TODO: ADD NEW DECOMPRESSORS HERE */
-            case 1: decompressionFunction = local_LZ4_decompress_zfs; break;
+static int BMK_recordDecoded(int result, const struct zfsRecord* r)
+{
+    // On disk psize is rounded up to the sector size, zero padded. The lzjb.c
+    // decoders then return the bytes they consumed, less than psize : still a
+    // success, the output is judged against the other decoders.
+    return (result == (int)r->lsize) || ((result > 0) && ((U32)result < r->psize));
+}
 
-            case 2: decompressionFunction = local_LZJB_decompress_original; break;
-            case 3: decompressionFunction = local_LZJB_decompress_bsd; break;
-            case 4: decompressionFunction = local_LZJB_decompress_hack; break;
+static int BMK_replayRecords(char* fileName)
+{
+    static const U32 zioTypes[] = { ZIO_COMPRESS_LZJB, ZIO_COMPRESS_LZ4 };
+    static const int zioFormats[] = { FORMAT_LZJB, FORMAT_ZFS_LZ4 };
+    char* dump = NULL;
+    struct zfsRecord* records = NULL;
+    char* reference = NULL;
+    char* output = NULL;
+    int nbRecords = 0, i, t, dAlgNb, nbFailures = 0, nbOff = 0, nbOther = 0;
+    U64 logicalSize = 0;
+    int result = BMK_loadRecords(fileName, &dump, &records, &nbRecords);
+
+    if (result) return result;
+    for (i=0; i<nbRecords; i++)
+    {
+        logicalSize += records[i].lsize;
+        if (records[i].compression == ZIO_COMPRESS_OFF) nbOff++;
+        else if ((records[i].compression != ZIO_COMPRESS_LZJB) && (records[i].compression != ZIO_COMPRESS_LZ4)) nbOther++;
+    }
+    DISPLAY("\r%79s\r", "");
+    DISPLAY(" %s : %i records, %i MB logical, %i uncompressed, %i of other compressions skipped\n", fileName, nbRecords, (int)(logicalSize>>20), nbOff, nbOther);
 
-            default : DISPLAY("ERROR ! Bad algorithm Id !! \n"); free(chunkP); return 1;
-            }
+    for (t=0; t<(int)(sizeof(zioTypes)/sizeof(zioTypes[0])); t++)
+    {
+        size_t totalL = 0, totalP = 0;
+        int nbTyped = 0, haveReference = 0;
+
+        for (i=0; i<nbRecords; i++)
+        {
+            if (records[i].compression != zioTypes[t]) continue;
+            records[i].outputPos = totalL;
+            totalL += records[i].lsize;
+            totalP += records[i].psize;
+            nbTyped++;
+        }
+        if (nbTyped == 0) continue;
+        free(reference); free(output);
+        reference = (char*) malloc(totalL + 1);
+        output = (char*) malloc(totalL + 1);
+        if ((reference==NULL) || (output==NULL)) { DISPLAY("\nError: not enough memory!\n"); result = 12; goto _cleanup; }
+        DISPLAY("%i %s records, %i KB -> %i KB (%5.2f%%)\n", nbTyped, formatNames[zioFormats[t]], (int)(totalL>>10), (int)(totalP>>10), (double)totalP / totalL * 100.);
+
+        for (dAlgNb=0; dAlgNb<NB_DECOMPRESSION_ALGORITHMS; dAlgNb++)
+        {
+            decompressor_t decompressionFunction;
+            double bestTime = 100000000.;
+            int loopNb, nbWrong = 0, nbDiffer = 0, firstBad = -1;
+
+            if ((decompressionFormats[dAlgNb] != zioFormats[t]) || !BMK_decompressorSelected(dAlgNb)) continue;
+            if (BMK_selectDecompressor(dAlgNb, &decompressionFunction)) continue;
 
             for (loopNb = 1; loopNb <= nbIterations; loopNb++)
             {
+                int nb_loops = 0, milliTime;
                 double averageTime;
-                int milliTime;
-                U32 crcDecoded;
 
-                DISPLAY("%1i-%-24.24s :%10i ->\r", loopNb, dName, (int)benchedSize);
-
-                nb_loops = 0;
+                DISPLAY("%1i-%-21.21s :\r", loopNb, decompressionNames[dAlgNb]);
+                memset(output, 0, totalL);
                 milliTime = BMK_GetMilliStart();
                 while(BMK_GetMilliStart() == milliTime);
                 milliTime = BMK_GetMilliStart();
                 while(BMK_GetMilliSpan(milliTime) < TIMELOOP)
                 {
-                    for (chunkNb=0; chunkNb<nbChunks; chunkNb++)
-                    {
-                        int decodedSize = 0;
-                        if (dAlgNb < FIRST_LZJB_DECO) {
-                          decodedSize = decompressionFunction(chunkP[chunkNb].compressedBuffer, chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedSize, chunkP[chunkNb].origSize);
-                        }
-                        else {
-                          decodedSize = decompressionFunction(chunkP[chunkNb].compressedLZJBBuffer, chunkP[chunkNb].origBuffer, chunkP[chunkNb].compressedLZJBSize, chunkP[chunkNb].origSize);
-                        }
-                        if (chunkP[chunkNb].origSize != decodedSize)
-                        {
-                          DISPLAY("ERROR @ Chunk %i ! %s() == %i != %i !! \n", chunkNb, dName, decodedSize, chunkP[chunkNb].origSize);
-                          compareBufferToFile(chunkP[chunkNb].origBuffer, decodedSize, inFileName, chunkNb*chunkSize);
-                          exit(1);
-                        }
-                    }
+                    for (i=0; i<nbRecords; i++)
+                        if (records[i].compression == zioTypes[t])
+                            decompressionFunction(records[i].payload, output + records[i].outputPos, records[i].psize, records[i].lsize);
                     nb_loops++;
                 }
-                milliTime = BMK_GetMilliSpan(milliTime);
-
-                averageTime = (double)milliTime / nb_loops;
+                averageTime = (double)BMK_GetMilliSpan(milliTime) / nb_loops;
                 if (averageTime < bestTime) bestTime = averageTime;
+            }
 
-                DISPLAY("%1i-%-24.24s :%10i -> %7.1f MB/s\r", loopNb, dName, (int)benchedSize, (double)benchedSize / bestTime / 1000.);
-
-                // CRC Checking
-                crcDecoded = XXH32(orig_buff, (int)benchedSize, 0);
-                if (crcOriginal!=crcDecoded) {
-                    DISPLAY("\n!!! WARNING !!! %14s : Invalid Checksum : %x != %x\n", inFileName, (unsigned)crcOriginal, (unsigned)crcDecoded);
-                    /*WARNINGS, shouldn't exit. exit(1);*/
-                    compareBufferToFile(orig_buff, benchedSize, inFileName, 0);
+            // One checked pass : the decoded size, then the bytes against the reference
+            memset(output, 0, totalL);
+            for (i=0; i<nbRecords; i++)
+            {
+                struct zfsRecord* r = &records[i];
+                if (r->compression != zioTypes[t]) continue;
+                if (!BMK_recordDecoded(decompressionFunction(r->payload, output + r->outputPos, r->psize, r->lsize), r))
+                {
+                    nbWrong++;
+                    if (firstBad < 0) firstBad = i;
+                }
+                else if (haveReference && memcmp(output + r->outputPos, reference + r->outputPos, r->lsize))
+                {
+                    nbDiffer++;
+                    if (firstBad < 0) firstBad = i;
                 }
             }
 
-            DISPLAY("%-26.26s :%10i -> %7.1f MB/s\n", dName, (int)benchedSize, (double)benchedSize / bestTime / 1000.);
-
-            totalDTime[dAlgNb] += bestTime;
+            DISPLAY("%-23.23s : %8.1f MB/s, ", decompressionNames[dAlgNb], (double)totalL / bestTime / 1000.);
+            if (nbWrong || nbDiffer)
+            {
+                DISPLAY("FAILED : %i record(s) with a wrong size, %i differ(s) from the reference (first : record %i)\n", nbWrong, nbDiffer, firstBad);
+                nbFailures++;
+            }
+            else if (!haveReference)
+            {
+                memcpy(reference, output, totalL);
+                haveReference = 1;
+                DISPLAY("reference\n");
+            }
+            else DISPLAY("same output as the reference\n");
         }
+    }
+
+_cleanup:
+    free(reference);
+    free(output);
+    free(records);
+    free(dump);
+    if (result) return result;
+    return nbFailures ? 15 : 0;
+}
+
+int BMK_recordDumpBench(char** fileNames, int nbFiles)
+{
+    int i, result = 0;
+    for (i=0; (i<nbFiles) && (result==0 || result==15); i++)
+    {
+        int fileResult = BMK_replayRecords(fileNames[i]);
+        if (fileResult) result = fileResult;
+    }
+    return result;
+}
+
+
+int fullSpeedBench(char** fileNamesTable, int nbFiles)
+{
+  int fileIdx=0;
+  int inputNb=0, nbInputs = nbFiles + (synthetic.size > 0);
+  int sizeNb, algNb;
+  double totalCTime[MAX_BLOCK_SIZES][NB_COMPRESSION_ALGORITHMS] = {{0}};
+  double totalCSize[MAX_BLOCK_SIZES][NB_COMPRESSION_ALGORITHMS] = {{0}};
+  double totalDTime[MAX_BLOCK_SIZES][NB_DECOMPRESSION_ALGORITHMS] = {{0}};
+
+  U64 totals = 0;
+
+  if (nbBlockSizes == 0) blockSizes[nbBlockSizes++] = chunkSize;
+
+  // Loop for each file, synthetic data first
+  while (inputNb<nbInputs)
+  {
+      char* inFileName;
+      U64   inFileSize;
+      U64   fileBenchedSize;
+      int result;
+      double fileCTime[MAX_BLOCK_SIZES][NB_COMPRESSION_ALGORITHMS] = {{0}};
+      double fileCSize[MAX_BLOCK_SIZES][NB_COMPRESSION_ALGORITHMS] = {{0}};
+      double fileDTime[MAX_BLOCK_SIZES][NB_DECOMPRESSION_ALGORITHMS] = {{0}};
+
+      if ((synthetic.size > 0) && (inputNb == 0))
+      {
+          static char syntheticName[] = "synthetic";
+          inFileName = syntheticName;
+          result = BMK_benchSynthetic(inFileName, &fileBenchedSize, fileCTime, fileCSize, fileDTime);
+      }
+      else
+      {
+          inFileName = fileNamesTable[fileIdx++];
+          inFileSize = BMK_GetFileSize(inFileName);
+
+#if !defined(BMK_NO_MMAP)
+          if (mapInput)
+          {
+              // The whole file is benchmarked, one window at a time
+              result = BMK_benchMappedFile(inFileName, inFileSize, fileCTime, fileCSize, fileDTime);
+              fileBenchedSize = inFileSize;
+          }
+          else
+#endif
+          {
+              size_t benchedSize = 0;
+              result = BMK_benchReadFile(inFileName, inFileSize, &benchedSize, fileCTime, fileCSize, fileDTime);
+              fileBenchedSize = benchedSize;
+          }
+      }
+      inputNb++;
+      if (result) return result;
 
-        totals += benchedSize;
+      for (sizeNb=0; sizeNb<nbBlockSizes; sizeNb++)
+      {
+          for (algNb=0; algNb<NB_COMPRESSION_ALGORITHMS; algNb++)
+          {
+              totalCTime[sizeNb][algNb] += fileCTime[sizeNb][algNb];
+              totalCSize[sizeNb][algNb] += fileCSize[sizeNb][algNb];
+          }
+          for (algNb=0; algNb<NB_DECOMPRESSION_ALGORITHMS; algNb++)
+              totalDTime[sizeNb][algNb] += fileDTime[sizeNb][algNb];
+      }
+
+      if ((benchMode == MODE_STANDARD) && (nbBlockSizes > 1))
+      {
+          DISPLAY(" ** %s : block size sweep ** \n", inFileName);
+          BMK_displaySweep((double)fileBenchedSize, fileCTime, fileCSize, fileDTime);
       }
 
-      free(orig_buff);
-      free(compressed_buff);
-      free(chunkP);
+      totals += fileBenchedSize;
+  }
+
+  if ((nbInputs >= 1) && (benchMode == MODE_STANDARD) && (nbBlockSizes > 1))
+  {
+      DISPLAY(" ** TOTAL : block size sweep ** \n");
+      BMK_displaySweep((double)totals, totalCTime, totalCSize, totalDTime);
   }
 
-  if (nbFiles >= 1)
+  if ((nbInputs >= 1) && (benchMode == MODE_STANDARD) && (nbBlockSizes == 1))
   {
       int AlgNb;
 
@@ -789,14 +5320,14 @@ int fullSpeedBench(char** fileNamesTable, int nbFiles)
       for (AlgNb = 0; (AlgNb < NB_COMPRESSION_ALGORITHMS) && (compressionTest); AlgNb ++)
       {
           char* cName = compressionNames[AlgNb];
-          if ((compressionAlgo != ALL_COMPRESSORS) && ((compressionAlgo & (1 << AlgNb))==0)) continue;
-          DISPLAY("%-21.21s :%10llu ->%10llu (%5.2f%%), %6.1f MB/s\n", cName, (long long unsigned int)totals, (long long unsigned int)totalCSize[AlgNb], (double)totalCSize[AlgNb]/(double)totals*100., (double)totals/totalCTime[AlgNb]/1000.);
+          if (!BMK_compressorSelected(AlgNb)) continue;
+          DISPLAY("%-21.21s :%10llu ->%10llu (%5.2f%%), %6.1f MB/s\n", cName, (long long unsigned int)totals, (long long unsigned int)totalCSize[0][AlgNb], (double)totalCSize[0][AlgNb]/(double)totals*100., (double)totals/totalCTime[0][AlgNb]/1000.);
       }
       for (AlgNb = 0; (AlgNb < NB_DECOMPRESSION_ALGORITHMS) && (decompressionTest); AlgNb ++)
       {
           char* dName = decompressionNames[AlgNb];
-          if ((decompressionAlgo != ALL_DECOMPRESSORS) && ((decompressionAlgo & (1 << AlgNb))==0)) continue;
-          DISPLAY("%-21.21s :%10llu -> %6.1f MB/s\n", dName, (long long unsigned int)totals, (double)totals/totalDTime[AlgNb]/1000.);
+          if (!BMK_decompressorSelected(AlgNb)) continue;
+          DISPLAY("%-21.21s :%10llu -> %6.1f MB/s\n", dName, (long long unsigned int)totals, (double)totals/totalDTime[0][AlgNb]/1000.);
       }
   }
 
@@ -824,6 +5355,31 @@ int usage_advanced()
     DISPLAY( " -d#/-D# : test only compression function # [%c-%c] (can specify multiple like -c123. -D wont stop comp.)\n", MINDECOMPRESSIONCHAR, MAXDECOMPRESSIONCHAR);
     DISPLAY( " -i#     : iteration loops [1-9](default : %i)\n", NBLOOPS);
     DISPLAY( " -B#     : Block size [0-7] {512!,1K,4K,16K,64K,256K,1M,4M} (default : 7 {4M})\n");
+    DISPLAY( " -B#K,#M : Block size(s) with a K or M suffix; a list (like -B8K,32K,128K) sweeps them all\n");
+    DISPLAY( " -t      : report hot, warm and cold cache throughput side by side\n");
+    DISPLAY( " -w      : working set sweep, from one block up to %i x LLC, at the -B block size\n", SWEEP_LLC_MULTIPLE);
+    DISPLAY( " -s#     : sample until the 95%% CI is within +/-#%% (like -s2 or -s0.5), report mean/median/stddev\n");
+    DISPLAY( " -z#     : ZFS compression decision (keep blocks saving >= 12.5%%) with ashift # [9-16] (default : %i)\n", ZFS_DEFAULT_ASHIFT);
+    DISPLAY( " -A[i|o] : alignment sweep, input and output (-Ai input, -Ao output) at +0,1,2,4,8,16,32,63 bytes, or -A0,3,5\n");
+    DISPLAY( " -W      : worst case TSC ticks/byte of every codec on pathological inputs, 128K records (or -B)\n");
+    DISPLAY( " -N[t,s,d]: NUMA : thread on node t, codec input on node s, output on node d; omitted nodes are swept\n");
+    DISPLAY( " -G file : Pareto report of ratio, compress and decode MB/s over codecs x block sizes, gnuplot data to file\n");
+    DISPLAY( " -Z      : files are ZFS record dumps (lzjbstat -o format), decoded as is and cross-checked\n");
+    DISPLAY( " -M      : matrix : each compressor feeds each decompressor of its format, checked and timed\n");
+    DISPLAY( " -X[cpt]#: codecs under # antagonist threads (default 1) at 25/50/100%% duty : copy, pointer chase, LLC thrash\n");
+    DISPLAY( " -j#     : scaling test with 1, 2, 4 ... # concurrent workers [1-999]\n");
+    DISPLAY( " -R#,#   : read latency percentiles of # decompression threads, under # compression threads\n");
+    DISPLAY( " -r file : replay an I/O trace of '<c|d> <offset> <length> <codec>' lines against each file\n");
+    DISPLAY( " -a#     : buffer pages [0-3] {4K, mlocked pre-faulted, THP, hugetlb}; -a alone compares them\n");
+    DISPLAY( " -g spec : also bench synthetic data, spec like size=16M,ratio=50,offset=1-8:30/9-1023:70,match=3-66,literal=1-16,seed=1\n");
+    DISPLAY( " -o file : save results (file, block, codec, best/mean/stddev MB/s, ratio) to file\n");
+    DISPLAY( " -b file : compare with baseline results from -o, flag regressions (no files : rerun the baseline)\n");
+    DISPLAY( " -x#     : regression threshold in %% (default : 5)\n");
+    DISPLAY( " -L file : load a codec plugin (.so, see fullbench_plugin.h), as codecs %c-%c, up to %i\n", MINCOMPRESSIONCHAR + NB_BUILTIN_COMPRESSORS, MINCOMPRESSIONCHAR + NB_COMPRESSION_ALGORITHMS - 1, MAX_PLUGINS);
+    DISPLAY( " -P#     : pin to cpu # (-P alone : the current cpu), one cpu per thread with -j and -X\n");
+    DISPLAY( " -F      : run SCHED_FIFO (falls back to nice -20), needs CAP_SYS_NICE\n");
+    DISPLAY( " -S      : refuse to run when the governor, turbo or load make the system noisy\n");
+    DISPLAY( " -m/-mp  : mmap inputs (-mp : pre-populated) and bench files larger than RAM in windows\n");
 
     //DISPLAY( " -BD    : Block dependency (improve compression ratio)\n");
     return 0;
@@ -840,7 +5396,8 @@ int badusage(char* exename)
 int main(int argc, char** argv)
 {
     int i,
-        filenamesStart=2;
+        filenamesStart=2,
+        result;
     char* exename=argv[0];
     char* input_filename=0;
 
@@ -890,30 +5447,48 @@ int main(int argc, char** argv)
 
                     // Modify Block Properties
                 case 'B':
-                    while (argument[1]!=0)
-                    switch(argument[1])
-                    {
-                    case '0': /* Special Case (512 bytes) */
-                      DISPLAY("WARNING: ZFS LZJB can not handle a block size of 512 bytes, minimum is 1K.\n");
-                    case '1': /* 1K */
-                    case '2': /* 4K */
-                    case '3': /* 16K */
-                    case '4': /* 64K */
-                    case '5': /* 256K */
-                    case '6': /* 1M */
-                    case '7': /* 4M */
                     {
-                        int B = argument[1] - '0';
-                        int S = 512;
-                        if (B > 0) S = 1 << (8 + 2*B);
-                        BMK_SetBlocksize(S);
-                        argument++;
-                        break;
-                    }
-                    case 'D': argument++; break;
-                    default : goto _exit_blockProperties;
+                        // Digits only : legacy size codes [0-7], the last one wins (-B12 is 4K).
+                        // Otherwise sizes with a K/M suffix, a list sweeps them (-B8K,32K,128K)
+                        int n = 1;
+                        while ((argument[n] >= '0') && (argument[n] <= '9')) n++;
+                        if ((argument[n]!='K') && (argument[n]!='k') && (argument[n]!='M') && (argument[n]!='m') && (argument[n]!=','))
+                        {
+                            int S = 0;
+                            while (argument[1]!=0)
+                            {
+                                if ((argument[1] >= '0') && (argument[1] <= '7')) { int B = argument[1] - '0'; S = B ? 1 << (8 + 2*B) : 512; argument++; continue; }
+                                if (argument[1]=='D') { argument++; continue; }
+                                break;
+                            }
+                            if (S == 512) /* Special Case (512 bytes) */
+                              DISPLAY("WARNING: ZFS LZJB can not handle a block size of 512 bytes, minimum is 1K.\n");
+                            if (S) { BMK_ClearBlockSizes(); BMK_SetBlocksize(S); }
+                            break;
+                        }
+                        BMK_ClearBlockSizes();
+                        while (argument[1]!=0)
+                        {
+                            if ((argument[1] >= '0') && (argument[1] <= '9'))
+                            {
+                                int value = 0;
+                                int S = -1;
+                                while ((argument[1] >= '0') && (argument[1] <= '9'))
+                                {
+                                    value = (value > LZ4_MAX_INPUT_SIZE/10) ? LZ4_MAX_INPUT_SIZE+1 : value*10 + (argument[1] - '0');
+                                    argument++;
+                                }
+                                if ((argument[1]=='K') || (argument[1]=='k')) { S = (value > (LZ4_MAX_INPUT_SIZE>>10)) ? -1 : value << 10; argument++; }
+                                else if ((argument[1]=='M') || (argument[1]=='m')) { S = (value > (LZ4_MAX_INPUT_SIZE>>20)) ? -1 : value << 20; argument++; }
+                                if ((S <= 0) || (S > LZ4_MAX_INPUT_SIZE)) { badusage(exename); return 1; }
+                                BMK_SetBlocksize(S);
+                                if (argument[1]==',') argument++;
+                                continue;
+                            }
+                            if (argument[1]=='D') { argument++; continue; }
+                            break;
+                        }
                     }
-_exit_blockProperties:
                     break;
 
                     // Modify Nb Iterations
@@ -926,9 +5501,202 @@ _exit_blockProperties:
                     }
                     break;
 
+                    // Cache temperature tests
+                case 't': BMK_SetCacheTest(); break;
+
+                    // Working set sweep
+                case 'w': BMK_SetWorkingSetSweep(); break;
+
+                    // Statistical run control
+                case 's':
+                    {
+                        double target = 0., scale = 1.;
+                        while (((argument[1] >='0') && (argument[1] <='9')) || ((argument[1]=='.') && (scale==1.)))
+                        {
+                            if (argument[1]=='.') scale = 0.1;
+                            else if (scale < 1.) { target += (argument[1] - '0') * scale; scale /= 10.; }
+                            else target = target*10 + (argument[1] - '0');
+                            argument++;
+                        }
+                        if (target <= 0.) { badusage(exename); return 1; }
+                        BMK_SetStatTarget(target);
+                    }
+                    break;
+
+                    // ZFS compression decision, with ashift (default 12)
+                case 'z':
+                    {
+                        int ashift = 0;
+                        while ((argument[1] >='0') && (argument[1] <='9')) { ashift = ashift*10 + (argument[1] - '0'); argument++; }
+                        if (ashift == 0) ashift = ZFS_DEFAULT_ASHIFT;
+                        if ((ashift < 9) || (ashift > 16)) { badusage(exename); return 1; }
+                        BMK_SetZfsAshift(ashift);
+                    }
+                    break;
+
+                    // Compressor x decompressor matrix
+                case 'M': BMK_SetMatrix(); break;
+
+                    // Alignment sweep : -A[i|o][#,#,...], offsets 0-63
+                case 'A':
+                    {
+                        int sides = ALIGN_BOTH;
+                        if (argument[1]=='i') { sides = ALIGN_INPUT; argument++; }
+                        else if (argument[1]=='o') { sides = ALIGN_OUTPUT; argument++; }
+                        BMK_SetAlignSweep(sides);
+                        while ((argument[1] >='0') && (argument[1] <='9'))
+                        {
+                            int offset = 0;
+                            while ((argument[1] >='0') && (argument[1] <='9')) { offset = offset*10 + (argument[1] - '0'); argument++; if (offset > ALIGN_MAX) { badusage(exename); return 1; } }
+                            BMK_AddAlignOffset(offset);
+                            if (argument[1]==',') argument++;
+                        }
+                    }
+                    break;
+
+                    // Concurrent workers
+                case 'j':
+                    {
+                        int workers = 0;
+                        while ((argument[1] >='0') && (argument[1] <='9') && (workers < 100))
+                        {
+                            workers = workers*10 + (argument[1] - '0');
+                            argument++;
+                        }
+                        if (workers < 1) { badusage(exename); return 1; }
+                        BMK_SetNbWorkers(workers);
+                    }
+                    break;
+
+                    // Antagonists : kinds, then number of threads
+                case 'X':
+                    {
+                        int kinds = 0, count = 0;
+                        while ((argument[1]=='c') || (argument[1]=='p') || (argument[1]=='t'))
+                        {
+                            kinds |= (argument[1]=='c') ? ANTAGONIST_COPY : (argument[1]=='p') ? ANTAGONIST_CHASE : ANTAGONIST_THRASH;
+                            argument++;
+                        }
+                        while ((argument[1] >='0') && (argument[1] <='9') && (count < 100)) { count = count*10 + (argument[1] - '0'); argument++; }
+                        BMK_SetAntagonists(kinds ? kinds : ANTAGONIST_ALL, count ? count : 1);
+                    }
+                    break;
+
+                    // Readers and writers : latency of decompression under compression load
+                case 'R':
+                    {
+                        int threads[2] = { 0, -1 };
+                        int n = 0;
+                        while ((n < 2) && (argument[1] >='0') && (argument[1] <='9'))
+                        {
+                            threads[n] = 0;
+                            while ((argument[1] >='0') && (argument[1] <='9') && (threads[n] < 100)) { threads[n] = threads[n]*10 + (argument[1] - '0'); argument++; }
+                            n++;
+                            if (argument[1]==',') argument++;
+                        }
+                        if (threads[0] < 1) { badusage(exename); return 1; }
+                        BMK_SetMixedLoad(threads[0], (threads[1] < 0) ? threads[0] : threads[1]);
+                    }
+                    break;
+
+                    // Replay an I/O trace (file name is the next argument)
+                case 'r':
+                    if (i+1 >= argc) { badusage(exename); return 1; }
+                    BMK_SetTraceFile(argv[++i]);
+                    break;
+
+                    // Synthetic data (spec is the next argument)
+                case 'g':
+                    if (i+1 >= argc) { badusage(exename); return 1; }
+                    if (BMK_SetSynthetic(argv[++i])) { badusage(exename); return 1; }
+                    break;
+
+                    // Save results (file name is the next argument)
+                case 'o':
+                    if (i+1 >= argc) { badusage(exename); return 1; }
+                    BMK_SetResultFile(argv[++i]);
+                    break;
+
+                    // Compare against a baseline result file (next argument)
+                case 'b':
+                    if (i+1 >= argc) { badusage(exename); return 1; }
+                    BMK_SetBaseline(argv[++i]);
+                    break;
+
+                    // Regression threshold, in %
+                case 'x':
+                    {
+                        int threshold = 0;
+                        while ((argument[1] >='0') && (argument[1] <='9') && (threshold < 1000)) { threshold = threshold*10 + (argument[1] - '0'); argument++; }
+                        BMK_SetRegressionThreshold((double)threshold);
+                    }
+                    break;
+
+                    // Pareto report (gnuplot data file is the next argument)
+                case 'G':
+                    if (i+1 >= argc) { badusage(exename); return 1; }
+                    BMK_SetPareto(argv[++i]);
+                    break;
+
+                    // ZFS record dumps
+                case 'Z': BMK_SetRecordDumps(); break;
+
+                    // Worst case inputs
+                case 'W': BMK_SetWorstCase(); break;
+
+                    // NUMA placement : thread, source and destination nodes
+                case 'N':
+                    {
+                        int nodes[3] = { NUMA_ANY, NUMA_ANY, NUMA_ANY };
+                        int n = 0;
+                        while ((n < 3) && (argument[1] >='0') && (argument[1] <='9'))
+                        {
+                            nodes[n] = 0;
+                            while ((argument[1] >='0') && (argument[1] <='9')) { nodes[n] = nodes[n]*10 + (argument[1] - '0'); argument++; if (nodes[n] >= NUMA_MAX_NODES) { badusage(exename); return 1; } }
+                            n++;
+                            if (argument[1]==',') argument++;
+                        }
+                        BMK_SetNuma(nodes[0], nodes[1], nodes[2]);
+                    }
+                    break;
+
+                    // Load a codec plugin (file name is the next argument)
+                case 'L':
+                    if (i+1 >= argc) { badusage(exename); return 1; }
+                    if (BMK_LoadPlugin(argv[++i])) return 1;
+                    break;
+
+                    // Pin to cpu # (-P alone : the current cpu)
+                case 'P':
+                    {
+                        int cpu = 0;
+                        if ((argument[1] < '0') || (argument[1] > '9')) { BMK_SetPinCPU(PIN_CURRENT); break; }
+                        while ((argument[1] >='0') && (argument[1] <='9') && (cpu < 100000)) { cpu = cpu*10 + (argument[1] - '0'); argument++; }
+                        BMK_SetPinCPU(cpu);
+                    }
+                    break;
+
+                    // SCHED_FIFO, falls back to nice -20
+                case 'F': BMK_SetSchedFifo(); break;
+
+                    // Refuse to run in a noisy environment
+                case 'S': BMK_SetStrictIsolation(); break;
+
                     // Pause at the end (hidden option)
                 case 'p': BMK_SetPause(); break;
 
+                    // Buffer pages : -a0 4K, -a1 locked, -a2 THP, -a3 hugetlb, -a alone compares them
+                case 'a':
+                    if ((argument[1] >= '0') && (argument[1] <= '3')) { argument++; BMK_SetPageMode(*argument - '0'); }
+                    else BMK_SetPageMode(-1);
+                    break;
+
+                    // Memory mapped input, by windows, mp : pre-populated
+                case 'm':
+                    if (argument[1]=='p') { argument++; BMK_SetMapInput(MAP_INPUT_POPULATE); }
+                    else BMK_SetMapInput(MAP_INPUT_MMAP);
+                    break;
+
                     // Unrecognised command
                 default : badusage(exename); return 1;
                 }
@@ -941,9 +5709,62 @@ _exit_blockProperties:
 
     }
 
-    // No input filename ==> Error
-    if(!input_filename) { badusage(exename); return 1; }
+    // Only the standard mode records results
+    if ((resultFileName || baselineFileName) && (benchMode != MODE_STANDARD))
+    {
+        DISPLAY("Error: -o and -b only apply to the standard benchmark\n");
+        return 1;
+    }
+    if (paretoFileName && (benchMode != MODE_PARETO))
+    {
+        DISPLAY("Error: -G can not be combined with another benchmark mode\n");
+        return 1;
+    }
+    if ((benchMode == MODE_WORST) && input_filename)
+        DISPLAY("WARNING: -W benchmarks inputs of its own, file arguments are ignored\n");
+
+    if (baselineFileName)
+    {
+        int error = BMK_loadResults(baselineFileName, &baselineResults);
+        if (error) return error;
+    }
+
+    // The ZFS lz4 reference streams are built without the compressor's initFunction
+    lz4_init();
 
-    return fullSpeedBench(argv+filenamesStart, argc-filenamesStart);
+    BMK_fingerprint();
+    result = BMK_isolate();
+    if (result) return result;
+    if (benchMode == MODE_WORST) return BMK_worstCaseBench();
+    if (benchMode == MODE_RECORDS)
+    {
+        if (!input_filename) { badusage(exename); return 1; }
+        return BMK_recordDumpBench(argv+filenamesStart, argc-filenamesStart);
+    }
 
+    // No input filename ==> Error, unless synthetic data is generated or a baseline gives the files
+    if(!input_filename)
+    {
+        if (baselineFileName)
+        {
+            char* baselineFiles[MAX_BASELINE_FILES];
+            int nbFiles = BMK_baselineMatrix(baselineFiles, MAX_BASELINE_FILES);
+            if ((nbFiles == 0) && (synthetic.size == 0)) { DISPLAY("Error: no baseline file to bench\n"); return 1; }
+            result = fullSpeedBench(baselineFiles, nbFiles);
+        }
+        else
+        {
+            if (synthetic.size == 0) { badusage(exename); return 1; }
+            result = fullSpeedBench(NULL, 0);
+        }
+    }
+    else result = fullSpeedBench(argv+filenamesStart, argc-filenamesStart);
+
+    if (result) return result;
+    if (paretoFileName) result = BMK_paretoReport(paretoFileName);
+    if (result) return result;
+    if (resultFileName) result = BMK_saveResults(resultFileName);
+    if (result) return result;
+    if (baselineFileName && BMK_compareBaseline()) return REGRESSION_EXIT_CODE;
+    return 0;
 }
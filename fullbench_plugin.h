@@ -0,0 +1,80 @@
+/*
+    fullbench_plugin.h - codec plugin interface of fullbench
+    GPL v2 License
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    A plugin is a shared object exporting FULLBENCH_PLUGIN_ENTRY, loaded with
+    fullbench -L file.so. Its codec runs through the same timing and
+    verification loops as the built-in ones, after them in the tables.
+    lzjb_plugin.c is an example.
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+//**************************************
+// Version
+//**************************************
+// Incremented on any change of fullbench_plugin_t; older plugins are refused
+#define FULLBENCH_PLUGIN_VERSION 1
+
+
+//**************************************
+// Stream formats
+//**************************************
+// Decompressors are fed blocks compressed by the reference compressor of
+// their format; compressors are checked against the decompressors of theirs.
+#define FULLBENCH_FORMAT_LZ4      0   // LZ4 block, as LZ4_compress()
+#define FULLBENCH_FORMAT_ZFS_LZ4  1   // ZFS lz4 block
+#define FULLBENCH_FORMAT_LZJB     2   // LZJB, as ZFS lzjb_compress()
+
+
+//**************************************
+// Codec
+//**************************************
+typedef struct
+{
+    int         version;        // FULLBENCH_PLUGIN_VERSION
+    const char* name;           // table label, must differ from the built-in codecs
+    int         format;         // FULLBENCH_FORMAT_*
+
+    // Compresses srcSize bytes into dst (dstCapacity bytes available).
+    // Returns the compressed size, 0 on error; ZFS compressors return srcSize
+    // when the block does not fit. NULL : the plugin only decompresses.
+    int (*compress)(const char* src, char* dst, int srcSize, int dstCapacity);
+
+    // Decompresses srcSize bytes into dst, which receives exactly dstSize bytes.
+    // Returns dstSize, or a negative value on error. NULL : compressor only.
+    int (*decompress)(const char* src, char* dst, int srcSize, int dstSize);
+
+    // Worst case compressed size of srcSize bytes. NULL : same as LZ4_compressBound()
+    int (*bound)(int srcSize);
+
+    // Called once after loading. Returns 0 on success. May be NULL.
+    int (*init)(void);
+} fullbench_plugin_t;
+
+// Every plugin exports :  const fullbench_plugin_t* fullbench_plugin(void);
+#define FULLBENCH_PLUGIN_ENTRY "fullbench_plugin"
+typedef const fullbench_plugin_t* (*fullbench_plugin_entry_t)(void);
+
+
+#if defined (__cplusplus)
+}
+#endif
@@ -28,13 +28,28 @@
 //**************************************
 #define _CRT_SECURE_NO_WARNINGS  // fgets
 
+// mmap(MAP_ANONYMOUS), sigaction and sigsetjmp for the guarded LZJB buffers
+#if defined(__linux__)
+#  define _GNU_SOURCE
+#endif
+
 
 //**************************************
 // Includes
 //**************************************
 #include <stdlib.h>
 #include <stdio.h>      // fgets, sscanf
+#include <string.h>     // memcmp, memcpy
 #include <sys/timeb.h>  // timeb
+#if !defined(_WIN32)
+#  include <unistd.h>     // sysconf
+#  include <sys/mman.h>   // mmap, mprotect
+#  include <signal.h>     // sigaction
+#  include <setjmp.h>     // sigsetjmp
+#  define FUZ_GUARD_PAGES 1
+#else
+#  define FUZ_GUARD_PAGES 0
+#endif
 #include "lz4.h"
 #include "lz4hc.h"
 
@@ -55,6 +70,13 @@
 #define PRIME2   2246822519U
 #define PRIME3   3266489917U
 
+// LZJB fuzzer
+#define LZJB_MAX_LEN      (128<<10)                 // largest ZFS record
+#define LZJB_SRC_BOUND(d) ((d) + ((d)>>3) + 32)     // stream bytes a decoder may read for d output bytes
+#define LZJB_SLACK        1024                      // lzjb_decompress_fast : n = d_len + LZJB_SLACK, full speed up to d_len
+#define LZJB_NB_CASES     (1<<17)
+#define ZIO_COMPRESS_LZJB 3                         // record dump format of lzjbstat
+
 
 //*********************************************************
 //  Functions
@@ -118,8 +140,386 @@ int FUZ_SecurityTest()
 }
 
 
-//int main(int argc, char *argv[]) {
-int main() {
+//*********************************************************
+//  LZJB differential fuzzer
+//*********************************************************
+// Each case builds a stream (a valid one from lzjb_compress, a mutated one,
+// a random sequence of literals and matches, or random bytes) and decodes it
+// with lzjb_decompress, lzjb_decompress_bsd and lzjb_decompress_fast, the
+// latter twice : n = 0 (no slack) and n = d_len + LZJB_SLACK.
+// Every buffer sits against PROT_NONE guard pages, alternately at the end and
+// at the start of its pages, so an out of bounds access faults at once.
+// A plain walk of the stream gives the expected result of each decoder, and
+// which output bytes are defined : a match of offset 0 copies whatever the
+// destination held, which differs between decoders that over-copy.
+extern size_t lzjb_compress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+extern int lzjb_decompress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+extern int lzjb_decompress_bsd(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+extern int lzjb_decompress_fast(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+
+#define LZJB_WALK_OK        0
+#define LZJB_WALK_UNDERRUN  1   // a match starts before the block : every decoder fails
+#define LZJB_WALK_TRUNCATED 2   // the last match runs past d_len : ZFS cuts it, fast rejects it
+
+static const char* FUZ_lzjbKinds[] = { "valid", "mutated", "random sequences", "random bytes" };
+
+typedef struct
+{
+    unsigned char* pages;     // first usable page, a guard page sits on each side
+    size_t size;              // usable bytes, whole pages
+} FUZ_guarded;
+
+static struct
+{
+    const char* volatile stage;
+    volatile int caseNb;
+    volatile int kind;
+    volatile int d_len;
+    volatile int s_len;
+    unsigned char* src;
+} FUZ_lzjbCase;
+
+static FUZ_guarded FUZ_srcPages, FUZ_dstPages, FUZ_dataPages;
+
+#if FUZ_GUARD_PAGES
+static sigjmp_buf FUZ_faultJump;
+static void* volatile FUZ_faultAddress;
+
+static void FUZ_faultHandler(int sig, siginfo_t* info, void* context)
+{
+    (void)context;
+    FUZ_faultAddress = info->si_addr;
+    siglongjmp(FUZ_faultJump, sig);
+}
+#endif
+
+
+static int FUZ_guardedAlloc(FUZ_guarded* g, size_t size)
+{
+#if FUZ_GUARD_PAGES
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    unsigned char* map;
+    g->size = (size + pageSize - 1) & ~(pageSize - 1);
+    map = (unsigned char*) mmap(NULL, g->size + 2*pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) return 1;
+    if (mprotect(map, pageSize, PROT_NONE) || mprotect(map + pageSize + g->size, pageSize, PROT_NONE)) return 1;
+    g->pages = map + pageSize;
+#else
+    g->size = size;
+    g->pages = (unsigned char*) malloc(size);
+    if (g->pages == NULL) return 1;
+#endif
+    return 0;
+}
+
+
+static void FUZ_guardedFree(FUZ_guarded* g)
+{
+#if FUZ_GUARD_PAGES
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    munmap(g->pages - pageSize, g->size + 2*pageSize);
+#else
+    free(g->pages);
+#endif
+}
+
+
+// Buffer of 'size' bytes flush against the guard page after it, or before it
+static unsigned char* FUZ_guardedPlace(FUZ_guarded* g, size_t size, int atEnd)
+{
+    return atEnd ? g->pages + g->size - size : g->pages;
+}
+
+
+static int FUZ_lzjbWalk(const unsigned char* src, int d_len, unsigned char* defined, int* pos, int* consumed)
+{
+    const unsigned char* ip = src;
+    unsigned char copymap = 0;
+    int copymask = 1 << 7;
+    int op = 0, status = LZJB_WALK_OK;
+
+    while (op < d_len)
+    {
+        if ((copymask <<= 1) == (1 << 8)) { copymask = 1; copymap = *ip++; }
+        if (copymap & copymask)
+        {
+            int mlen = (ip[0] >> 2) + 3;
+            int offset = ((ip[0] << 8) | ip[1]) & 1023;
+            ip += 2;
+            if (offset > op) { status = LZJB_WALK_UNDERRUN; break; }
+            if (mlen > d_len - op) { status = LZJB_WALK_TRUNCATED; break; }
+            for ( ; mlen; mlen--, op++) defined[op] = offset ? defined[op - offset] : 0;
+        }
+        else { ip++; defined[op++] = 1; }
+    }
+    *pos = op;
+    *consumed = (int)(ip - src);
+    return status;
+}
+
+
+// Compressible data : literals from a small alphabet, and copies from up to 1100 bytes back
+static void FUZ_lzjbData(unsigned char* data, int size, unsigned int* randState)
+{
+    int alphabet = 2 + (FUZ_rand(randState) >> 16) % 62;
+    int pos = 0;
+    while (pos < size)
+    {
+        int r = FUZ_rand(randState) >> 8;
+        if ((r & 3) || (pos < 2))
+            data[pos++] = (unsigned char)((FUZ_rand(randState) >> 16) % alphabet);
+        else
+        {
+            int offset = 1 + (r >> 2) % ((pos < 1100) ? pos : 1100);
+            int length = 1 + (FUZ_rand(randState) >> 16) % 80;
+            while (length-- && (pos < size)) { data[pos] = data[pos - offset]; pos++; }
+        }
+    }
+}
+
+
+// Literals and matches with mostly plausible offsets; the last match may cross d_len
+static int FUZ_lzjbSequences(unsigned char* stream, int d_len, unsigned int* randState)
+{
+    int matchShare = (FUZ_rand(randState) >> 16) % 101;
+    unsigned char* ip = stream;
+    unsigned char* copymap = NULL;
+    int copymask = 1 << 7;
+    int op = 0;
+
+    while (op < d_len)
+    {
+        if ((copymask <<= 1) == (1 << 8)) { copymask = 1; copymap = ip++; *copymap = 0; }
+        if ((int)((FUZ_rand(randState) >> 16) % 100) < matchShare)
+        {
+            int r = FUZ_rand(randState) >> 8;
+            int mlen = 3 + (r & 63);
+            int offset;
+            int kind = (r >> 6) & 63;
+            if (kind == 0) offset = (r >> 12) & 1023;                                   // anywhere, may underrun
+            else if (kind < 16) offset = 1 + ((r >> 12) & 7);                           // run length paths
+            else offset = op ? 1 + (int)((unsigned)(r >> 12) % (op < 1023 ? op : 1023)) : 0;
+            *copymap |= copymask;
+            *ip++ = (unsigned char)(((mlen - 3) << 2) | (offset >> 8));
+            *ip++ = (unsigned char)offset;
+            op += mlen;
+        }
+        else { *ip++ = (unsigned char)(FUZ_rand(randState) >> 16); op++; }
+    }
+    return (int)(ip - stream);
+}
+
+
+static void FUZ_lzjbMutate(unsigned char* stream, int* s_len, unsigned int* randState)
+{
+    int nbMutations = 1 + (FUZ_rand(randState) >> 16) % 8;
+    while (nbMutations--)
+    {
+        int r = FUZ_rand(randState) >> 8;
+        int pos = (int)((unsigned)FUZ_rand(randState) % (unsigned)*s_len);
+        switch (r & 3)
+        {
+        case 0 : stream[pos] ^= (unsigned char)(1 << ((r >> 2) & 7)); break;     // bit flip
+        case 1 : stream[pos] = (unsigned char)(r >> 8); break;                   // random byte
+        case 2 : stream[pos] = 0xFF; break;                                      // all matches, or longest match
+        default: if (pos) *s_len = pos; break;                                   // truncated stream
+        }
+    }
+}
+
+
+// First defined byte that differs, -1 if none
+static int FUZ_lzjbCompare(const unsigned char* out, const unsigned char* reference, const unsigned char* defined, int size)
+{
+    int i;
+    for (i = 0; i < size; i++)
+        if ((out[i] != reference[i]) && defined[i]) return i;
+    return -1;
+}
+
+
+static void FUZ_lzjbSaveCase(unsigned int seed)
+{
+    // One record in lzjbstat's dump format, for 'lzjbstat -r'
+    char fileName[64];
+    unsigned char header[12];
+    unsigned int values[3];
+    FILE* f;
+    int i;
+
+    values[0] = (unsigned int)FUZ_lzjbCase.d_len;
+    values[1] = (unsigned int)LZJB_SRC_BOUND(FUZ_lzjbCase.d_len);
+    values[2] = ZIO_COMPRESS_LZJB;
+    for (i=0; i<12; i++) header[i] = (unsigned char)(values[i/4] >> (8*(i&3)));
+    sprintf(fileName, "lzjb-fuzz-%u-%i.dump", seed, FUZ_lzjbCase.caseNb);
+    f = fopen(fileName, "wb");
+    if (f == NULL) return;
+    fwrite(header, 1, 12, f);
+    fwrite(FUZ_lzjbCase.src, 1, values[1], f);
+    fclose(f);
+    printf("stream saved to %s, with the padding read past s_len (%u bytes)\n", fileName, values[1]);
+}
+
+
+static int FUZ_lzjbRun(unsigned int seed, int nbCases)
+{
+    unsigned char* stream = (unsigned char*) malloc(LZJB_SRC_BOUND(LZJB_MAX_LEN));
+    unsigned char* reference = (unsigned char*) malloc(LZJB_MAX_LEN);
+    unsigned char* defined = (unsigned char*) malloc(LZJB_MAX_LEN);
+    unsigned int randState = seed;
+    unsigned long long decodedBytes = 0;
+    int kindCount[4] = { 0, 0, 0, 0 }, statusCount[3] = { 0, 0, 0 }, trailingFailures = 0;
+    int caseNb, milliStart, milliSpan, k;
+#   define FUZ_LZJB_CHECK(cond, ...) if (cond) { printf("\nError (seed %u, case %i, %s stream, d_len %i, s_len %i) : ", seed, caseNb, FUZ_lzjbKinds[kind], d_len, s_len); \
+                                                 printf(__VA_ARGS__); printf("\n"); FUZ_lzjbSaveCase(seed); return 1; }
+
+    if ((stream == NULL) || (reference == NULL) || (defined == NULL)) { printf("Error : not enough memory\n"); return 1; }
+
+    milliStart = FUZ_GetMilliStart();
+    for (caseNb = 0; caseNb < nbCases; caseNb++)
+    {
+        int kind = (FUZ_rand(&randState) >> 16) & 3;
+        int bits = (FUZ_rand(&randState) >> 16) % 18;
+        int d_len = (bits == 17) ? LZJB_MAX_LEN : 1 + (int)((FUZ_rand(&randState) >> 8) % (1U << bits));
+        int atEnd = caseNb & 1;
+        int s_len, srcBound = LZJB_SRC_BOUND(d_len);
+        int status, pos, consumed, expected, ret, diff;
+        unsigned char* src = FUZ_guardedPlace(&FUZ_srcPages, srcBound, atEnd);
+        unsigned char* dst;
+
+        FUZ_lzjbCase.caseNb = caseNb;
+        FUZ_lzjbCase.d_len = d_len;
+        FUZ_lzjbCase.s_len = 0;
+        FUZ_lzjbCase.src = src;
+
+        // Build the stream, padded with random bytes up to the read bound
+        for (k = 0; k < srcBound; k++) stream[k] = (unsigned char)(FUZ_rand(&randState) >> 16);
+        s_len = srcBound;
+        if (kind <= 1)
+        {
+            unsigned char* data = FUZ_guardedPlace(&FUZ_dataPages, d_len, atEnd);
+            unsigned char* compressed = FUZ_guardedPlace(&FUZ_srcPages, d_len, !atEnd);
+            FUZ_lzjbData(data, d_len, &randState);
+            FUZ_lzjbCase.stage = "lzjb_compress";
+            s_len = (int)lzjb_compress(data, compressed, d_len, d_len, 0);
+            if (s_len < d_len)
+            {
+                memcpy(stream, compressed, s_len);
+                memcpy(reference, data, d_len);
+            }
+            else kind = 2;    // incompressible : ZFS would store it raw
+        }
+        if (kind == 1) FUZ_lzjbMutate(stream, &s_len, &randState);
+        if (kind == 2) s_len = FUZ_lzjbSequences(stream, d_len, &randState);
+        memcpy(src, stream, srcBound);
+        FUZ_lzjbCase.kind = kind;
+        FUZ_lzjbCase.s_len = s_len;
+        kindCount[kind]++;
+
+        status = FUZ_lzjbWalk(stream, d_len, defined, &pos, &consumed);
+        statusCount[status]++;
+        FUZ_LZJB_CHECK(consumed > srcBound, "stream walk read %i bytes, more than the %i bytes bound", consumed, srcBound);
+        if (kind == 0) FUZ_LZJB_CHECK((status != LZJB_WALK_OK) || (consumed != s_len), "lzjb_compress produced an invalid stream");
+
+        // ZFS decoder : the reference output
+        expected = (status == LZJB_WALK_UNDERRUN) ? -1 : ((consumed == s_len) ? 0 : consumed);
+        dst = FUZ_guardedPlace(&FUZ_dstPages, d_len, atEnd);
+        memset(dst, 0xA5, d_len);
+        FUZ_lzjbCase.stage = "lzjb_decompress";
+        ret = lzjb_decompress(src, dst, s_len, d_len, 0);
+        FUZ_LZJB_CHECK(ret != expected, "lzjb_decompress returned %i instead of %i", ret, expected);
+        if (kind == 0) FUZ_LZJB_CHECK(memcmp(dst, reference, d_len), "lzjb_decompress output differs from the original data");
+        memcpy(reference, dst, d_len);
+
+        // BSD decoder : same result, same output
+        memset(dst, 0xA5, d_len);
+        FUZ_lzjbCase.stage = "lzjb_decompress_bsd";
+        ret = lzjb_decompress_bsd(src, dst, s_len, d_len, 0);
+        FUZ_LZJB_CHECK(ret != expected, "lzjb_decompress_bsd returned %i instead of %i", ret, expected);
+        FUZ_LZJB_CHECK(memcmp(dst, reference, d_len), "lzjb_decompress_bsd output differs from lzjb_decompress");
+
+        // Fast decoder : fails on underrun (-1) and on a truncated last match (-2),
+        // output matches up to where it stopped. With slack it decodes the whole
+        // last copymap, and may fail on matches in its bits past d_len.
+        expected = (status == LZJB_WALK_UNDERRUN) ? -1 : ((status == LZJB_WALK_TRUNCATED) ? -2 : 0);
+        for (k = 0; k < 2; k++)
+        {
+            int n = k ? d_len + LZJB_SLACK : 0;
+            dst = FUZ_guardedPlace(&FUZ_dstPages, k ? d_len + LZJB_SLACK : d_len, atEnd);
+            memset(dst, 0xA5, d_len);
+            FUZ_lzjbCase.stage = k ? "lzjb_decompress_fast (n = d_len + slack)" : "lzjb_decompress_fast (n = 0)";
+            ret = lzjb_decompress_fast(src, dst, s_len, d_len, n);
+            if (k && (expected == 0) && (ret < 0)) { trailingFailures++; ret = 0; }
+            FUZ_LZJB_CHECK(ret != expected, "%s returned %i instead of %i", FUZ_lzjbCase.stage, ret, expected);
+            diff = FUZ_lzjbCompare(dst, reference, defined, pos);
+            FUZ_LZJB_CHECK(diff >= 0, "%s output differs from lzjb_decompress at byte %i", FUZ_lzjbCase.stage, diff);
+        }
+
+        decodedBytes += (unsigned long long)d_len * 4;
+        if ((caseNb & 255) == 255)
+        {
+            milliSpan = FUZ_GetMilliSpan(milliStart);
+            if (milliSpan > 0) printf("\r%7i /%7i   - %8.0f cases/s ", caseNb+1, nbCases, (double)(caseNb+1) * 1000. / milliSpan);
+            fflush(stdout);
+        }
+    }
+    milliSpan = FUZ_GetMilliSpan(milliStart);
+    if (milliSpan == 0) milliSpan = 1;
+
+    printf("\r%7i cases passed in %.1f s : %.0f cases/s, %.1f MB/s decoded          \n", nbCases, milliSpan / 1000.,
+           (double)nbCases * 1000. / milliSpan, (double)decodedBytes / milliSpan / 1000.);
+    printf("streams : %i valid, %i mutated, %i random sequences, %i random bytes\n", kindCount[0], kindCount[1], kindCount[2], kindCount[3]);
+    printf("ending  : %i complete, %i match before the block, %i last match truncated\n", statusCount[0], statusCount[1], statusCount[2]);
+    printf("lzjb_decompress_fast with slack rejected %i streams on bits past d_len\n", trailingFailures);
+
+    free(stream);
+    free(reference);
+    free(defined);
+    return 0;
+}
+
+
+int FUZ_lzjbTest(unsigned int seed, int nbCases)
+{
+    int result;
+
+    if (FUZ_guardedAlloc(&FUZ_srcPages, LZJB_SRC_BOUND(LZJB_MAX_LEN)) || FUZ_guardedAlloc(&FUZ_dstPages, LZJB_MAX_LEN + LZJB_SLACK) ||
+        FUZ_guardedAlloc(&FUZ_dataPages, LZJB_MAX_LEN))
+    { printf("Error : not enough memory\n"); return 1; }
+
+    printf("starting LZJB differential fuzzer : %i cases, seed %u%s\n", nbCases, seed, FUZ_GUARD_PAGES ? "" : " (no guard pages on this system)");
+
+#if FUZ_GUARD_PAGES
+    {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = FUZ_faultHandler;
+        sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigaction(SIGSEGV, &sa, NULL);
+        sigaction(SIGBUS, &sa, NULL);
+    }
+    if (sigsetjmp(FUZ_faultJump, 1))
+    {
+        printf("\nError (seed %u, case %i, %s stream, d_len %i, s_len %i) : %s faulted at %p\n", seed, FUZ_lzjbCase.caseNb,
+               FUZ_lzjbKinds[FUZ_lzjbCase.kind], FUZ_lzjbCase.d_len, FUZ_lzjbCase.s_len, FUZ_lzjbCase.stage, FUZ_faultAddress);
+        printf("usable pages : source %p-%p, destination %p-%p, data %p-%p\n",
+               FUZ_srcPages.pages, FUZ_srcPages.pages + FUZ_srcPages.size, FUZ_dstPages.pages, FUZ_dstPages.pages + FUZ_dstPages.size,
+               FUZ_dataPages.pages, FUZ_dataPages.pages + FUZ_dataPages.size);
+        FUZ_lzjbSaveCase(seed);
+        return 1;
+    }
+#endif
+
+    result = FUZ_lzjbRun(seed, nbCases);
+
+    FUZ_guardedFree(&FUZ_srcPages);
+    FUZ_guardedFree(&FUZ_dstPages);
+    FUZ_guardedFree(&FUZ_dataPages);
+    return result;
+}
+
+
+int main(int argc, char** argv) {
         unsigned long long bytes = 0;
         unsigned long long cbytes = 0;
         unsigned long long hcbytes = 0;
@@ -132,9 +532,24 @@ int main() {
         unsigned int seed, randState, cur_seq=PRIME3, seeds[NUM_SEQ], timestamp=FUZ_GetMilliStart();
         int i, j, k, ret, len, lenHC, attemptNb;
         char userInput[30] = {0};
+        int lzjbTest = 0, nbCases = LZJB_NB_CASES, seedSet = 0;
 #       define FUZ_CHECKTEST(cond, message) if (cond) { printf("Test %i : %s : seed %u, cycle %i \n", testNb, message, seed, attemptNb); goto _output_error; }
 #       define FUZ_DISPLAYTEST              testNb++; printf("%2i\b\b", testNb);
 
+        // -j : LZJB differential fuzzer, -s# : seed, -i# : number of cases
+        for (i = 1; i < argc; i++)
+        {
+            if (!strcmp(argv[i], "-j")) lzjbTest = 1;
+            else if (!strncmp(argv[i], "-s", 2) && argv[i][2]) { seed = (unsigned int)strtoul(argv[i]+2, NULL, 10); seedSet = 1; }
+            else if (!strncmp(argv[i], "-i", 2) && argv[i][2]) nbCases = atoi(argv[i]+2);
+            else { printf("usage : %s [-j [-s#] [-i#]]\n  -j  : LZJB differential fuzzer\n  -s# : seed (default : time)\n  -i# : number of cases (default : %i)\n", argv[0], LZJB_NB_CASES); return 1; }
+        }
+        if (lzjbTest)
+        {
+            if (!seedSet) seed = FUZ_GetMilliSpan(timestamp) ^ (unsigned int)FUZ_GetMilliStart();
+            return FUZ_lzjbTest(seed, nbCases);
+        }
+
         printf("starting LZ4 fuzzer\n");
         printf("Select an Initialisation number (default : random) : ");
         fflush(stdout);
@@ -146,9 +146,17 @@
 //**************************************
 // Memory routines
 //**************************************
-#include <stdlib.h>   // malloc, calloc, free
-#define ALLOCATOR(n,s) calloc(n,s)
-#define FREEMEM        free
+#if defined(MEMSTAT)
+#  include "memstat.h"   // allocation accounting (fullbench)
+#  define ALLOCATOR(n,s) MEMSTAT_calloc(n,s)
+#  define FREEMEM        MEMSTAT_free
+#  define STACKSTATE(s)  MEMSTAT_stack(s)
+#else
+#  include <stdlib.h>   // malloc, calloc, free
+#  define ALLOCATOR(n,s) calloc(n,s)
+#  define FREEMEM        free
+#  define STACKSTATE(s)
+#endif
 #include <string.h>   // memset, memcpy
 #define MEM_INIT       memset
 
@@ -552,6 +560,7 @@ int LZ4_compress(const char* source, char* dest, int inputSize)
     void* ctx = ALLOCATOR(HASHNBCELLS4, 4);   // Aligned on 4-bytes boundaries
 #else
     U32 ctx[1U<<(MEMORY_USAGE-2)] = {0};           // Ensure data is aligned on 4-bytes boundaries
+    STACKSTATE(sizeof(ctx));
 #endif
     int result;
 
@@ -578,6 +587,7 @@ int LZ4_compress_limitedOutput(const char* source, char* dest, int inputSize, in
     void* ctx = ALLOCATOR(HASHNBCELLS4, 4);   // Aligned on 4-bytes boundaries
 #else
     U32 ctx[1U<<(MEMORY_USAGE-2)] = {0};           // Ensure data is aligned on 4-bytes boundaries
+    STACKSTATE(sizeof(ctx));
 #endif
     int result;
 
@@ -34,9 +34,15 @@
 //**************************************
 // Memory routines
 //**************************************
-#include <stdlib.h>   // calloc, free
-#define ALLOCATOR(s)  calloc(1,s)
-#define FREEMEM       free
+#if defined(MEMSTAT)
+#  include "memstat.h"   // allocation accounting (fullbench)
+#  define ALLOCATOR(s)  MEMSTAT_calloc(1,s)
+#  define FREEMEM       MEMSTAT_free
+#else
+#  include <stdlib.h>   // calloc, free
+#  define ALLOCATOR(s)  calloc(1,s)
+#  define FREEMEM       free
+#endif
 #include <string.h>   // memset, memcpy
 #define MEM_INIT      memset
 
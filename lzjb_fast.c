@@ -190,6 +190,16 @@ typedef struct _U64_S {
 #define LZJB_OFFSET_BITS          (10)
 #define LZJB_MATCH_MIN            (3)
 #define LZJB_OFFSET_MASK          ((1<<LZJB_OFFSET_BITS)-1)
+#define LZJB_MATCH_MAX            ((1<<LZJB_MATCH_BITS) + LZJB_MATCH_MIN - 1)
+
+/*
+ * One copymap can expand to 8 matches of LZJB_MATCH_MAX bytes, and
+ * the word copies may write up to LZJB_OVERCOPY bytes past the end of
+ * a literal run or match (the 7 byte run length case writes 13).
+ * A copymap started this far from the end of the buffer is safe.
+ */
+#define LZJB_OVERCOPY             (LZJB_STEPSIZE*2)
+#define LZJB_SAFE_MARGIN          ((8 * LZJB_MATCH_MAX) + LZJB_OVERCOPY)
 
 #ifdef KERN_DEOPT
 __attribute__ ((__target__ ("no-mmx,no-sse,no-sse2")))
@@ -419,16 +429,18 @@ lzjb_decompress_fast(void *s_start, void *d_start, size_t s_len, size_t d_len, i
      * n       = in ZFS is compression factor.
      *           for lzjb decompression speed optimization it CAN
      *           specify the MAXIMUM safe size of the decompression
-     *           buffer.  Which, if it is at least 8 bytes larger than
-     *           d_len will allow decompression to run at maximum speed
-     *           without worrying about buffer over run.
+     *           buffer.  Which, if it is at least LZJB_SAFE_MARGIN
+     *           bytes larger than d_len will allow decompression to
+     *           run at maximum speed up to d_len.  The unused bits of
+     *           the last copymap must then be zero (as lzjb_compress
+     *           leaves them), or decoding may fail.
      *           IF n is less than d_len it will not apply.
      */
     uchar_t *src   = s_start; /* Current pos in src buffer */
     uchar_t *dst   = d_start; /* Current pos in dst buffer */
     uchar_t *d_end = dst + d_len; /* End of decompression marker */
-    uchar_t *s_end = d_end - LZJB_STEPSIZE;
-                              /* The safe end of decompression, after
+    uchar_t *w_end = d_end;   /* End of the writable buffer */
+    uchar_t *s_end = dst;     /* The safe end of decompression, after
                                * here we need to make sure no buffer
                                * over runs occur.
                                */
@@ -442,17 +454,15 @@ lzjb_decompress_fast(void *s_start, void *d_start, size_t s_len, size_t d_len, i
     /* Use the n parameter to get the true safe size of the
      * decompression buffer.
      *
-     * Because a copymap can represent 8 literals, the maximum overrun
-     * is 8 bytes.  This algorithm will perform better on 64 bit
-     * architectures.
+     * A whole copymap is decoded without looking at the end, so it
+     * can only be started LZJB_SAFE_MARGIN bytes before the end of
+     * the writable buffer.  This algorithm will perform better on
+     * 64 bit architectures.
      */
-    if (n > (int)d_len) {
-#if LZJB_ARCH64
-        s_end = MIN(d_end, (dst + n - LZJB_STEPSIZE));
-#else
-        s_end = MIN(d_end, (dst + n - (LZJB_STEPSIZE*2)));
-#endif
-    }
+    if (n > (int)d_len)
+        w_end = dst + n;
+    if (w_end - dst > LZJB_SAFE_MARGIN)
+        s_end = MIN(d_end, (w_end - LZJB_SAFE_MARGIN));
 
     /* The size of the destination buffer controls decompression.
      * The last copymap may not all be used, decompression stops
@@ -615,39 +625,45 @@ lzjb_decompress_fast(void *s_start, void *d_start, size_t s_len, size_t d_len, i
 
     }
 
-    /* Fix up last bytes, being careful not to over run the dst buffer. */
-    if (dst < d_end) {
-       /* Read the LAST copymap from the src buffer.
-        * This copymap may not be fully used.
-        * Because the safe_end is >= 8 bytes from the true dst end
-        * One copy map can easily represent 8 literals which is the
-        * worst case scenario.  Accordingly there will be no more.
-        */
-       copymap = *src++;
-       do {
-           if ((copymap & 1) == 0) {
-             *dst++ = *src++;
-           } else {
-             offset = BE_IN16(src);
-             run = (offset >> LZJB_OFFSET_BITS) + LZJB_MATCH_MIN;
-             offset &= LZJB_OFFSET_MASK;
-             src+=2;
-
-             cpy_s = dst - offset;
-             cpy_e = dst + run;
-
-             /* Sanity Check - Can not copy from before dst
-              * buffer, or after it.
-              */
-             if (cpy_s < (uchar_t *)d_start) return (-1);
-             if (cpy_e > (uchar_t *)d_end)   return (-2);
-
-             while (dst < cpy_e) {
-                 *dst++ = *cpy_s++;
-             }
-           }
-           copymap >>= 1;
-       } while (dst < d_end);
+    /* Fix up last bytes, being careful not to over run the dst buffer.
+     * Up to LZJB_SAFE_MARGIN bytes are left, which may take several
+     * copymaps.  Literals are copied one by one, matches with word
+     * copies only while the over copy stays within the buffer.
+     */
+    copyleft = 0;
+    while (dst < d_end) {
+        if (copyleft == 0) {
+            copymap  = *src++;
+            copyleft = 8;
+        }
+        if ((copymap & 1) == 0) {
+            *dst++ = *src++;
+        } else {
+            offset = BE_IN16(src);
+            run = (offset >> LZJB_OFFSET_BITS) + LZJB_MATCH_MIN;
+            offset &= LZJB_OFFSET_MASK;
+            src+=2;
+
+            cpy_s = dst - offset;
+            cpy_e = dst + run;
+
+            /* Sanity Check - Can not copy from before dst
+             * buffer, or after it.
+             */
+            if (cpy_s < (uchar_t *)d_start) return (-1);
+            if (cpy_e > (uchar_t *)d_end)   return (-2);
+
+            if ((offset >= LZJB_STEPSIZE) && (cpy_e + LZJB_OVERCOPY <= w_end)) {
+                LZJB_QUICKCOPY(cpy_s, dst, cpy_e);
+                dst = cpy_e;
+            } else {
+                while (dst < cpy_e) {
+                    *dst++ = *cpy_s++;
+                }
+            }
+        }
+        copymap >>= 1;
+        copyleft--;
     }
 
     return (0);
@@ -0,0 +1,30 @@
+/*
+    lzjb_format.h - LZJB bitstream constants
+    GPL v2 License
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    The stream format of lzjb.c (MATCH_BITS, MATCH_MIN), for the tools which
+    read or write LZJB streams themselves : lzjbstat and fullbench -W.
+    A match is 2 bytes, its length above LZJB_MATCH_MIN in the top
+    LZJB_MATCH_BITS bits and its offset in the LZJB_OFFSET_BITS others.
+*/
+#pragma once
+
+#define LZJB_MATCH_BITS     6
+#define LZJB_OFFSET_BITS    10
+#define LZJB_MATCH_MIN      3
+#define LZJB_MATCH_MAX      ((1 << LZJB_MATCH_BITS) + (LZJB_MATCH_MIN - 1))
+#define LZJB_OFFSET_MAX     ((1 << LZJB_OFFSET_BITS) - 1)
@@ -0,0 +1,73 @@
+/*
+    lzjb_plugin.c - LZJB as a fullbench plugin
+    GPL v2 License
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    Builds lzjb.c (or a patched copy of it) into a codec fullbench loads with
+    -L, so a candidate change is benchmarked without relinking fullbench :
+        make lzjb.so
+        ./fullbench -L ./lzjb.so -C35 -D25 file
+    Build several copies with different -DLZJB_PLUGIN_NAME to compare them.
+*/
+
+//**************************************
+// Includes
+//**************************************
+#include <stddef.h>      // size_t
+#include "fullbench_plugin.h"
+
+
+//**************************************
+// Constants
+//**************************************
+#ifndef LZJB_PLUGIN_NAME
+#  define LZJB_PLUGIN_NAME "PLG_lzjb"
+#endif
+
+
+//**************************************
+// Codec
+//**************************************
+extern size_t lzjb_compress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+extern int lzjb_decompress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+
+static int PLG_lzjbCompress(const char* src, char* dst, int srcSize, int dstCapacity)
+{
+    return (int)lzjb_compress((void*)src, dst, srcSize, dstCapacity, 0);
+}
+
+static int PLG_lzjbDecompress(const char* src, char* dst, int srcSize, int dstSize)
+{
+    // ZFS decompressors return 0 on success
+    if (lzjb_decompress((void*)src, dst, srcSize, dstSize, 0)) return -1;
+    return dstSize;
+}
+
+static const fullbench_plugin_t PLG_lzjb =
+{
+    FULLBENCH_PLUGIN_VERSION,
+    LZJB_PLUGIN_NAME,
+    FULLBENCH_FORMAT_LZJB,
+    PLG_lzjbCompress,
+    PLG_lzjbDecompress,
+    NULL,
+    NULL
+};
+
+const fullbench_plugin_t* fullbench_plugin(void)
+{
+    return &PLG_lzjb;
+}
@@ -0,0 +1,510 @@
+/*
+    lzjbstat.c - LZJB stream analyser
+    GPL v2 License
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    Reports what LZJB streams are made of : copymap values, literal runs,
+    match lengths and offsets, and how often each special case of
+    lzjb_decompress_fast() (lzjb_fast.c) would be taken.
+*/
+
+//**************************************
+// Compiler Options
+//**************************************
+// Disable some Visual warning messages
+#define _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_DEPRECATE     // VS2005
+
+
+//**************************************
+// Includes
+//**************************************
+#include <stdlib.h>      // malloc
+#include <stdio.h>       // fprintf, fopen, fread
+#include <string.h>      // memset
+#include "lzjb_format.h"
+
+
+//**************************************
+// Basic Types
+//**************************************
+#if defined (__STDC_VERSION__) && __STDC_VERSION__ >= 199901L   // C99
+# include <stdint.h>
+  typedef uint8_t  BYTE;
+  typedef uint16_t U16;
+  typedef uint32_t U32;
+  typedef uint64_t U64;
+#else
+  typedef unsigned char       BYTE;
+  typedef unsigned short      U16;
+  typedef unsigned int        U32;
+  typedef unsigned long long  U64;
+#endif
+
+
+//****************************
+// Constants
+//****************************
+#define PROGRAM_NAME "LZJB stream analyser"
+#define WELCOME_MESSAGE "*** %s %i-bits ***\n", PROGRAM_NAME, (int)(sizeof(void*)*8)
+
+#define DEFAULT_BLOCKSIZE   (128<<10)     // ZFS default recordsize
+#define MAX_BLOCKSIZE       (16<<20)
+
+// lzjb_decompress_fast() copies by machine word, and starts a copymap in its
+// main loop only LZJB_SAFE_MARGIN bytes before the end of the block
+#define LZJB_STEPSIZE       ((int)sizeof(void*))
+#define LZJB_OVERCOPY       (LZJB_STEPSIZE*2)
+#define LZJB_SAFE_MARGIN    ((8 * LZJB_MATCH_MAX) + LZJB_OVERCOPY)
+
+// Literal runs : 1 to 16 one by one, then by powers of 2
+#define LITERAL_CLASSES     40
+
+// Record dump : every record is a 12 bytes little endian header
+//    <lsize U32> <psize U32> <compression U32>
+// followed by psize bytes of payload. Compression uses the ZFS
+// enum zio_compress values; only LZJB records are analysed.
+#define ZIO_COMPRESS_OFF    2
+#define ZIO_COMPRESS_LZJB   3
+#define DUMP_HEADER_SIZE    12
+
+
+//**************************************
+// Macros
+//**************************************
+#define DISPLAY(...) fprintf(stderr, __VA_ARGS__)
+
+
+//**************************************
+// Compressors
+//**************************************
+typedef size_t (*lzjbCompressor_t)(void* s_start, void* d_start, size_t s_len, size_t d_len, int n);
+
+extern size_t lzjb_compress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n);
+
+static struct { char* name; lzjbCompressor_t compress; } compressors[] =
+{
+    { "ZFS_lzjb_compress", lzjb_compress },
+};
+#define NB_COMPRESSORS (int)(sizeof(compressors) / sizeof(compressors[0]))
+
+
+//**************************************
+// Statistics
+//**************************************
+struct streamStatistics
+{
+    U64 nbBlocks;
+    U64 nbStoredBlocks;       // not LZJB : stored raw, or another compression
+    U64 nbInvalidBlocks;
+    U64 origBytes;
+    U64 compressedBytes;
+
+    U64 copymap[256];
+    U64 literalRun[LITERAL_CLASSES];
+    U64 matchLength[LZJB_MATCH_MAX+1];
+    U64 offset[LZJB_OFFSET_MAX+1];
+    U64 nbLiterals;
+    U64 nbMatches;
+    U64 matchBytes;
+    U64 nbShortOffsets;       // offset <= 8
+    U64 nbOverlaps;           // offset < length
+
+    // lzjb_decompress_fast() paths
+    U64 fastMaps;             // copymaps decoded by the main loop
+    U64 fastZeroMaps;         // special case #1 : 8 literals
+    U64 fastTailLiterals;     // special case #2 : literals after the last match of a copymap
+    U64 fastLiteralSteps;     // literals copied by one word before a match
+    U64 fastRle[9];           // special case #3 : offset <= STEPSIZE and offset < length, by offset
+    U64 fastCopy[3];          // matches copied with 1, 2 or 3 words
+    U64 fastCopyLoop;         // longer matches, LZJB_QUICKCOPY
+    U64 tailMaps;             // copymaps decoded by the tail loop, near the end of the block
+    U64 tailWordCopies;       // tail matches copied by words, LZJB_QUICKCOPY
+    U64 tailBytes;            // tail literals and matches copied byte by byte
+};
+
+static int LZS_literalClass(int run)
+{
+    int c = 16;
+    if (run <= 16) return run - 1;
+    run = (run - 1) >> 4;
+    while (run > 1) { run >>= 1; c++; }
+    return (c < LITERAL_CLASSES) ? c : LITERAL_CLASSES - 1;
+}
+
+static void LZS_literalClassRange(int c, int* low, int* high)
+{
+    if (c < 16) { *low = *high = c + 1; return; }
+    *low = (1 << (c - 12)) + 1;
+    *high = 1 << (c - 11);
+}
+
+static int LZS_analyseBlock(struct streamStatistics* st, const BYTE* src, size_t srcSize, size_t dstSize)
+{
+    // Walks the stream the way lzjb_decompress() does, and sorts every
+    // copymap and match into the path lzjb_decompress_fast() would take.
+    // Returns 0 when the stream decodes exactly to dstSize bytes.
+    size_t ip = 0, pos = 0;
+    size_t safeEnd = (dstSize > (size_t)LZJB_SAFE_MARGIN) ? dstSize - LZJB_SAFE_MARGIN : 0;
+    int literalRun = 0;
+
+    while (pos < dstSize)
+    {
+        int map, bit, mainLoop, literalsInMap = 0;
+
+        if (ip >= srcSize) return 1;
+        map = src[ip++];
+        st->copymap[map]++;
+        mainLoop = (pos < safeEnd);
+        if (mainLoop) st->fastMaps++; else st->tailMaps++;
+        if (mainLoop && (map == 0)) st->fastZeroMaps++;
+        if (mainLoop && (map != 0) && (map < 0x80)) st->fastTailLiterals++;
+
+        for (bit=0; (bit<8) && (pos<dstSize); bit++)
+        {
+            int length, offset;
+
+            if (!(map & (1<<bit)))
+            {
+                if (ip >= srcSize) return 1;
+                ip++; pos++; literalRun++; literalsInMap++;
+                st->nbLiterals++;
+                if (!mainLoop) st->tailBytes++;
+                continue;
+            }
+
+            if (ip+2 > srcSize) return 1;
+            offset = (src[ip] << 8) | src[ip+1];
+            ip += 2;
+            length = (offset >> LZJB_OFFSET_BITS) + LZJB_MATCH_MIN;
+            offset &= LZJB_OFFSET_MAX;
+            if ((offset == 0) || ((size_t)offset > pos) || (pos + length > dstSize)) return 1;
+
+            if (literalRun) { st->literalRun[LZS_literalClass(literalRun)]++; literalRun = 0; }
+            st->matchLength[length]++;
+            st->offset[offset]++;
+            st->nbMatches++;
+            st->matchBytes += length;
+            if (offset <= 8) st->nbShortOffsets++;
+            if (offset < length) st->nbOverlaps++;
+
+            if (mainLoop)
+            {
+                if (literalsInMap) st->fastLiteralSteps++;
+                if ((offset <= LZJB_STEPSIZE) && (offset < length)) st->fastRle[offset]++;
+                else if (length <= LZJB_STEPSIZE) st->fastCopy[0]++;
+                else if (length <= LZJB_STEPSIZE*2) st->fastCopy[1]++;
+                else if (length <= LZJB_STEPSIZE*3) st->fastCopy[2]++;
+                else st->fastCopyLoop++;
+            }
+            else if ((offset >= LZJB_STEPSIZE) && (pos + length + LZJB_OVERCOPY <= dstSize)) st->tailWordCopies++;
+            else st->tailBytes += length;
+            literalsInMap = 0;
+            pos += length;
+        }
+    }
+    if (literalRun) st->literalRun[LZS_literalClass(literalRun)]++;
+
+    return 0;
+}
+
+static void LZS_addBlock(struct streamStatistics* st, const BYTE* src, size_t srcSize, size_t dstSize, int isLZJB)
+{
+    st->nbBlocks++;
+    st->origBytes += dstSize;
+    st->compressedBytes += srcSize;
+    if (!isLZJB) { st->nbStoredBlocks++; return; }
+    if (LZS_analyseBlock(st, src, srcSize, dstSize)) st->nbInvalidBlocks++;
+}
+
+
+//**************************************
+// Record dump
+//**************************************
+static U32 LZS_readLE32(const BYTE* p)
+{
+    return (U32)p[0] | ((U32)p[1] << 8) | ((U32)p[2] << 16) | ((U32)p[3] << 24);
+}
+
+static void LZS_writeLE32(BYTE* p, U32 v)
+{
+    p[0] = (BYTE)v; p[1] = (BYTE)(v >> 8); p[2] = (BYTE)(v >> 16); p[3] = (BYTE)(v >> 24);
+}
+
+static int LZS_writeRecord(FILE* f, const void* payload, U32 lsize, U32 psize, U32 compression)
+{
+    BYTE header[DUMP_HEADER_SIZE];
+    LZS_writeLE32(header, lsize);
+    LZS_writeLE32(header+4, psize);
+    LZS_writeLE32(header+8, compression);
+    if (fwrite(header, 1, DUMP_HEADER_SIZE, f) != DUMP_HEADER_SIZE) return 1;
+    if (fwrite(payload, 1, psize, f) != psize) return 1;
+    return 0;
+}
+
+static int LZS_analyseDump(struct streamStatistics* st, char* fileName)
+{
+    FILE* f = fopen(fileName, "rb");
+    BYTE* payload = (BYTE*) malloc(MAX_BLOCKSIZE);
+    BYTE header[DUMP_HEADER_SIZE];
+    int result = 0;
+
+    if ((f==NULL) || (payload==NULL))
+    {
+        DISPLAY("Problem opening %s\n", fileName);
+        if (f!=NULL) fclose(f);
+        free(payload);
+        return 11;
+    }
+
+    DISPLAY("Reading %s...\n", fileName);
+    while (fread(header, 1, DUMP_HEADER_SIZE, f) == DUMP_HEADER_SIZE)
+    {
+        U32 lsize = LZS_readLE32(header);
+        U32 psize = LZS_readLE32(header+4);
+        U32 compression = LZS_readLE32(header+8);
+        if ((lsize > MAX_BLOCKSIZE) || (psize > MAX_BLOCKSIZE) || (fread(payload, 1, psize, f) != psize))
+        {
+            DISPLAY("Error: '%s' is truncated or not a record dump (record %llu)\n", fileName, (long long unsigned int)st->nbBlocks);
+            result = 13;
+            break;
+        }
+        LZS_addBlock(st, payload, psize, lsize, compression == ZIO_COMPRESS_LZJB);
+    }
+
+    fclose(f);
+    free(payload);
+    return result;
+}
+
+static int LZS_analyseFile(struct streamStatistics* st, char* fileName, int blockSize, int compressorNb, FILE* dump)
+{
+    FILE* f = fopen(fileName, "rb");
+    BYTE* block = (BYTE*) malloc(blockSize);
+    BYTE* compressed = (BYTE*) malloc(blockSize);
+    size_t readSize;
+
+    if ((f==NULL) || (block==NULL) || (compressed==NULL))
+    {
+        DISPLAY("Problem opening %s\n", fileName);
+        if (f!=NULL) fclose(f);
+        free(block); free(compressed);
+        return 11;
+    }
+
+    DISPLAY("Compressing %s with %s, blocks of %i KB...\n", fileName, compressors[compressorNb].name, blockSize>>10);
+    while ((readSize = fread(block, 1, blockSize, f)) > 0)
+    {
+        // Same contract as in ZFS : the source length is returned when the block does not compress
+        size_t cSize = compressors[compressorNb].compress(block, compressed, readSize, readSize, 0);
+        int isLZJB = (cSize < readSize);
+        LZS_addBlock(st, isLZJB ? compressed : block, isLZJB ? cSize : readSize, readSize, isLZJB);
+        if ((dump!=NULL) && LZS_writeRecord(dump, isLZJB ? compressed : block, (U32)readSize, (U32)(isLZJB ? cSize : readSize), isLZJB ? ZIO_COMPRESS_LZJB : ZIO_COMPRESS_OFF))
+        {
+            DISPLAY("Error: can not write the record dump\n");
+            fclose(f); free(block); free(compressed);
+            return 14;
+        }
+    }
+
+    fclose(f);
+    free(block);
+    free(compressed);
+    return 0;
+}
+
+
+//**************************************
+// Report
+//**************************************
+static double LZS_share(U64 count, U64 total)
+{
+    return total ? (double)count / (double)total * 100. : 0.;
+}
+
+static void LZS_displayStatistics(const struct streamStatistics* st, int verbose)
+{
+    U64 nbMaps = st->fastMaps + st->tailMaps;
+    U64 lzjbBlocks = st->nbBlocks - st->nbStoredBlocks;
+    U64 nbRuns = 0;
+    int i, j;
+
+    DISPLAY("\n%llu blocks, %llu LZJB (%llu invalid), %llu stored ; %llu -> %llu bytes (%5.2f%%)\n",
+            (long long unsigned int)st->nbBlocks, (long long unsigned int)lzjbBlocks, (long long unsigned int)st->nbInvalidBlocks,
+            (long long unsigned int)st->nbStoredBlocks, (long long unsigned int)st->origBytes, (long long unsigned int)st->compressedBytes,
+            LZS_share(st->compressedBytes, st->origBytes));
+    DISPLAY("%llu copymaps, %llu literals, %llu matches covering %5.2f%% of the LZJB output\n",
+            (long long unsigned int)nbMaps, (long long unsigned int)st->nbLiterals, (long long unsigned int)st->nbMatches,
+            LZS_share(st->matchBytes, st->matchBytes + st->nbLiterals));
+    DISPLAY("offset <= 8      : %6.2f%% of matches\n", LZS_share(st->nbShortOffsets, st->nbMatches));
+    DISPLAY("offset < length  : %6.2f%% of matches\n", LZS_share(st->nbOverlaps, st->nbMatches));
+
+    DISPLAY("\nCopymap values (%% of copymaps), row = high nibble, column = low nibble\n    ");
+    for (j=0; j<16; j++) DISPLAY("    %X ", j);
+    DISPLAY("\n");
+    for (i=0; i<16; i++)
+    {
+        DISPLAY(" %X_ ", i);
+        for (j=0; j<16; j++) DISPLAY(" %5.2f", LZS_share(st->copymap[i*16+j], nbMaps));
+        DISPLAY("\n");
+    }
+
+    DISPLAY("\nLiteral runs\n");
+    for (i=0; i<LITERAL_CLASSES; i++) nbRuns += st->literalRun[i];
+    for (i=0; i<LITERAL_CLASSES; i++)
+    {
+        int low, high;
+        if (!st->literalRun[i]) continue;
+        LZS_literalClassRange(i, &low, &high);
+        if (i == LITERAL_CLASSES-1) DISPLAY(" %7i+       : %12llu %6.2f%%\n", low, (long long unsigned int)st->literalRun[i], LZS_share(st->literalRun[i], nbRuns));
+        else if (low == high) DISPLAY(" %7i        : %12llu %6.2f%%\n", low, (long long unsigned int)st->literalRun[i], LZS_share(st->literalRun[i], nbRuns));
+        else DISPLAY(" %7i-%-7i: %12llu %6.2f%%\n", low, high, (long long unsigned int)st->literalRun[i], LZS_share(st->literalRun[i], nbRuns));
+    }
+
+    DISPLAY("\nMatch lengths (%% of matches)\n");
+    for (i=LZJB_MATCH_MIN; i<=LZJB_MATCH_MAX; i++)
+    {
+        DISPLAY(" %2i:%6.2f", i, LZS_share(st->matchLength[i], st->nbMatches));
+        if (((i - LZJB_MATCH_MIN) % 8) == 7) DISPLAY("\n");
+    }
+
+    DISPLAY("\nOffsets (%% of matches)\n");
+    if (verbose)
+    {
+        for (i=1; i<=LZJB_OFFSET_MAX; i++)
+            if (st->offset[i]) DISPLAY(" %4i        : %12llu %6.2f%%\n", i, (long long unsigned int)st->offset[i], LZS_share(st->offset[i], st->nbMatches));
+    }
+    else
+    {
+        for (i=1; i<=8; i++) DISPLAY(" %4i        : %12llu %6.2f%%\n", i, (long long unsigned int)st->offset[i], LZS_share(st->offset[i], st->nbMatches));
+        for (i=8; i<=LZJB_OFFSET_MAX; i*=2)
+        {
+            U64 count = 0;
+            int high = (i*2 > LZJB_OFFSET_MAX) ? LZJB_OFFSET_MAX : i*2;
+            for (j=i+1; j<=high; j++) count += st->offset[j];
+            DISPLAY(" %4i-%-4i   : %12llu %6.2f%%\n", i+1, high, (long long unsigned int)count, LZS_share(count, st->nbMatches));
+            if (high == LZJB_OFFSET_MAX) break;
+        }
+    }
+
+    DISPLAY("\nlzjb_decompress_fast() paths (%i byte steps)\n", LZJB_STEPSIZE);
+    DISPLAY(" main loop copymaps          : %12llu %6.2f%% of copymaps\n", (long long unsigned int)st->fastMaps, LZS_share(st->fastMaps, nbMaps));
+    DISPLAY(" #1 zero copymap (8 literals): %12llu %6.2f%% of main loop copymaps\n", (long long unsigned int)st->fastZeroMaps, LZS_share(st->fastZeroMaps, st->fastMaps));
+    DISPLAY(" #2 literals after last match: %12llu %6.2f%% of main loop copymaps\n", (long long unsigned int)st->fastTailLiterals, LZS_share(st->fastTailLiterals, st->fastMaps));
+    DISPLAY(" literal step before a match : %12llu %6.2f%% of matches\n", (long long unsigned int)st->fastLiteralSteps, LZS_share(st->fastLiteralSteps, st->nbMatches));
+    for (i=1; i<=LZJB_STEPSIZE && i<=8; i++)
+        DISPLAY(" #3 RLE, offset %i            : %12llu %6.2f%% of matches\n", i, (long long unsigned int)st->fastRle[i], LZS_share(st->fastRle[i], st->nbMatches));
+    for (i=0; i<3; i++)
+        DISPLAY(" copy, length <= %2i          : %12llu %6.2f%% of matches\n", LZJB_STEPSIZE*(i+1), (long long unsigned int)st->fastCopy[i], LZS_share(st->fastCopy[i], st->nbMatches));
+    DISPLAY(" copy loop, length > %2i      : %12llu %6.2f%% of matches\n", LZJB_STEPSIZE*3, (long long unsigned int)st->fastCopyLoop, LZS_share(st->fastCopyLoop, st->nbMatches));
+    DISPLAY(" tail loop copymaps          : %12llu %6.2f%% of copymaps\n", (long long unsigned int)st->tailMaps, LZS_share(st->tailMaps, nbMaps));
+    DISPLAY(" tail copy by words          : %12llu %6.2f%% of matches\n", (long long unsigned int)st->tailWordCopies, LZS_share(st->tailWordCopies, st->nbMatches));
+    DISPLAY(" byte by byte tail           : %12llu %6.2f%% of the output\n", (long long unsigned int)st->tailBytes, LZS_share(st->tailBytes, st->origBytes));
+}
+
+
+//**************************************
+// Command line
+//**************************************
+static int usage(char* exename)
+{
+    DISPLAY( "Usage :\n");
+    DISPLAY( "      %s [arg] file1 file2 ... fileX\n", exename);
+    DISPLAY( "Arguments :\n");
+    DISPLAY( " -B#     : block size in bytes, or with K/M (default : %i KB)\n", DEFAULT_BLOCKSIZE>>10);
+    DISPLAY( " -c#     : compressor [0-%i] (default : 0)\n", NB_COMPRESSORS-1);
+    DISPLAY( " -r      : files are record dumps of compressed blocks, not raw data\n");
+    DISPLAY( " -o file : save the compressed blocks as a record dump\n");
+    DISPLAY( " -v      : list every offset\n");
+    DISPLAY( " -H      : Help (this text)\n");
+    DISPLAY( "Record dump : <lsize LE32> <psize LE32> <zio_compress LE32> <psize bytes>, repeated\n");
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    static struct streamStatistics st;
+    char* exename = argv[0];
+    char* dumpName = NULL;
+    FILE* dump = NULL;
+    int blockSize = DEFAULT_BLOCKSIZE;
+    int compressorNb = 0;
+    int readDumps = 0;
+    int verbose = 0;
+    int nbFiles = 0;
+    int i, result = 0;
+
+    DISPLAY( WELCOME_MESSAGE );
+    for (i=0; i<NB_COMPRESSORS; i++) DISPLAY(" compressor %i : %s\n", i, compressors[i].name);
+    if (argc<2) { usage(exename); return 1; }
+
+    for (i=1; i<argc; i++)
+    {
+        char* argument = argv[i];
+        if (argument[0]!='-') continue;
+        while (argument[1]!=0)
+        {
+            argument++;
+            switch(argument[0])
+            {
+            case 'B':
+                {
+                    U64 size = 0;
+                    while ((argument[1] >= '0') && (argument[1] <= '9') && (size <= MAX_BLOCKSIZE)) { size = size*10 + (argument[1] - '0'); argument++; }
+                    if ((argument[1]=='K') || (argument[1]=='k')) { size <<= 10; argument++; }
+                    else if ((argument[1]=='M') || (argument[1]=='m')) { size <<= 20; argument++; }
+                    if ((size == 0) || (size > MAX_BLOCKSIZE)) { usage(exename); return 1; }
+                    blockSize = (int)size;
+                }
+                break;
+            case 'c':
+                compressorNb = 0;
+                while ((argument[1] >= '0') && (argument[1] <= '9')) { compressorNb = compressorNb*10 + (argument[1] - '0'); argument++; }
+                if (compressorNb >= NB_COMPRESSORS) { usage(exename); return 1; }
+                break;
+            case 'r': readDumps = 1; break;
+            case 'v': verbose = 1; break;
+            case 'o':
+                if (i+1 >= argc) { usage(exename); return 1; }
+                dumpName = argv[++i];
+                argv[i] = (char*)"-";     // not an input file
+                break;
+            case 'H':
+            case 'h': usage(exename); return 0;
+            default : usage(exename); return 1;
+            }
+        }
+    }
+
+    if (dumpName!=NULL)
+    {
+        dump = fopen(dumpName, "wb");
+        if (dump==NULL) { DISPLAY("Error: can not create %s\n", dumpName); return 14; }
+    }
+
+    for (i=1; (i<argc) && !result; i++)
+    {
+        if (argv[i][0]=='-') continue;
+        nbFiles++;
+        if (readDumps) result = LZS_analyseDump(&st, argv[i]);
+        else result = LZS_analyseFile(&st, argv[i], blockSize, compressorNb, dump);
+    }
+    if (dump!=NULL) fclose(dump);
+    if (nbFiles == 0) { usage(exename); return 1; }
+
+    LZS_displayStatistics(&st, verbose);
+    return result;
+}
@@ -0,0 +1,103 @@
+/*
+    memstat.c - allocation accounting of the benchmarked codecs
+    GPL v2 License
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//**************************************
+// Includes
+//**************************************
+#include <stdlib.h>   // malloc, free
+#include <string.h>   // memset
+#include "memstat.h"
+
+
+//**************************************
+// Compiler Options
+//**************************************
+#if defined(_MSC_VER)
+#  define MEMSTAT_THREAD_LOCAL __declspec(thread)
+#else
+#  define MEMSTAT_THREAD_LOCAL __thread
+#endif
+
+
+//**************************************
+// Constants
+//**************************************
+// Each block starts with its size, on a header keeping malloc() alignment
+typedef union { size_t size; long double ld; void* p; long long ll; } memstat_header;
+#define MEMSTAT_HEADER sizeof(memstat_header)
+
+
+//**************************************
+// Counters, one set per thread
+//**************************************
+static MEMSTAT_THREAD_LOCAL memstat_t stats;
+
+
+//**************************************
+// Functions
+//**************************************
+void* MEMSTAT_malloc(size_t size)
+{
+    memstat_header* h = (memstat_header*) malloc(MEMSTAT_HEADER + size);
+    if (h == NULL) return NULL;
+    h->size = size;
+    stats.allocs++;
+    stats.bytes += size;
+    stats.live += size;
+    if (stats.live + stats.stack > stats.peak) stats.peak = stats.live + stats.stack;
+    return h + 1;
+}
+
+void* MEMSTAT_calloc(size_t nb, size_t size)
+{
+    void* ptr;
+    if ((size != 0) && (nb > ((size_t)-1 - MEMSTAT_HEADER) / size)) return NULL;
+    ptr = MEMSTAT_malloc(nb * size);
+    if (ptr != NULL) memset(ptr, 0, nb * size);
+    return ptr;
+}
+
+void MEMSTAT_free(void* ptr)
+{
+    memstat_header* h;
+    if (ptr == NULL) return;
+    h = (memstat_header*)ptr - 1;
+    stats.live -= h->size;
+    free(h);
+}
+
+void MEMSTAT_stack(size_t size)
+{
+    if (size > stats.stack) stats.stack = size;
+    if (stats.live + stats.stack > stats.peak) stats.peak = stats.live + stats.stack;
+}
+
+void MEMSTAT_reset(void)
+{
+    // Blocks still allocated stay live
+    stats.allocs = 0;
+    stats.bytes = 0;
+    stats.stack = 0;
+    stats.peak = stats.live;
+}
+
+memstat_t MEMSTAT_get(void)
+{
+    return stats;
+}
@@ -0,0 +1,55 @@
+/*
+    memstat.h - allocation accounting of the benchmarked codecs
+    GPL v2 License
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    Built with -DMEMSTAT (make fullbench-memstat), the allocators of lz4.c,
+    lz4hc.c and sys/zfs_context.h go through these functions, which count
+    allocations, bytes and the peak of live memory of the calling thread.
+    Memory they return must be released with MEMSTAT_free().
+*/
+#pragma once
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>   // size_t
+
+
+typedef struct
+{
+    unsigned long long allocs;   // allocations since MEMSTAT_reset()
+    unsigned long long bytes;    // bytes requested by them
+    size_t live;                 // heap bytes currently allocated
+    size_t peak;                 // highest live + stack since MEMSTAT_reset()
+    size_t stack;                // largest state declared on the stack
+} memstat_t;
+
+void* MEMSTAT_malloc(size_t size);
+void* MEMSTAT_calloc(size_t nb, size_t size);
+void  MEMSTAT_free(void* ptr);
+
+// State kept on the stack (LZ4 hash table when HEAPMODE is 0)
+void  MEMSTAT_stack(size_t size);
+
+void      MEMSTAT_reset(void);
+memstat_t MEMSTAT_get(void);
+
+
+#if defined (__cplusplus)
+}
+#endif
@@ -71,6 +71,21 @@ static inline __attribute_const__ __u32 __fswab32(__u32 val)
 
 #define KM_PUSHPAGE 0
 
+/*
+ * Allocation accounting : fullbench builds with -DMEMSTAT count what
+ * the codecs allocate, see memstat.h
+ */
+#if defined(MEMSTAT)
+#include "memstat.h"
+#define KMEM_ALLOC(size)        MEMSTAT_malloc(size)
+#define KMEM_ZALLOC(size)       MEMSTAT_calloc(1,size)
+#define KMEM_FREE(buf)          MEMSTAT_free(buf)
+#else
+#define KMEM_ALLOC(size)        malloc(size)
+#define KMEM_ZALLOC(size)       calloc(1,size)
+#define KMEM_FREE(buf)          free(buf)
+#endif
+
 typedef void* spl_kmem_ctor_t;
 typedef void* spl_kmem_dtor_t;
 typedef void* spl_kmem_reclaim_t;
@@ -87,7 +102,7 @@ static inline spl_kmem_cache_t *spl_kmem_cache_create(char *name __attribute__((
         void *priv __attribute__((__unused__)), void *vmp __attribute__((__unused__)),
         int flags __attribute__((__unused__)))
 {
-    kmem_cache_t* c = malloc(sizeof(kmem_cache_t));
+    kmem_cache_t* c = malloc(sizeof(kmem_cache_t));     /* not codec state, not counted */
     if (c != NULL)
       c->cache_size = size;
     return c;
@@ -97,13 +112,13 @@ static inline void *spl_kmem_cache_alloc(spl_kmem_cache_t *skc, int flags __attr
 {
     if (skc != NULL)
         if (skc->cache_size > 0)
-            return(malloc(skc->cache_size));
+            return(KMEM_ALLOC(skc->cache_size));
     return NULL;
 }
 
 static inline void spl_kmem_cache_free(spl_kmem_cache_t *skc __attribute__((__unused__)), void *obj)
 {
-    free(obj);
+    KMEM_FREE(obj);
 }
 
 static inline void spl_kmem_cache_destroy(spl_kmem_cache_t *skc)
@@ -111,8 +126,8 @@ static inline void spl_kmem_cache_destroy(spl_kmem_cache_t *skc)
     free(skc);
 }
 
-#define kmem_zalloc(size, flag) calloc(1,size);
-#define kmem_free(buf, size)    free(buf);
+#define kmem_zalloc(size, flag) KMEM_ZALLOC(size);
+#define kmem_free(buf, size)    KMEM_FREE(buf);
 
 #define kmem_cache_create(name,size,align,ctor,dtor,rclm,priv,vmp,flags) \
         spl_kmem_cache_create(name,size,align,ctor,dtor,rclm,priv,vmp,flags)
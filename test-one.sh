@@ -23,22 +23,16 @@
 # 4. Running out of memory.
 #
 # Fixes for these:
-# 1. Use taskset to set processor affinity to lock us to a core and its attendant caches.
+# 1. fullbench -P pins itself to a core and its attendant caches.
 CORE="1"
-# 2. Use nice to give the highest sheduling priority we can
-PRIO="-20"
-# 3. This changes the governor to performance, which maximizes the cpu core frequency.
-echo performance | tee /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor >/dev/null
-echo "Cores are set to:"
-for gov in `ls /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor`; do
-  scale=`cat ${gov}`
-  echo ${gov} = ${scale}
-done
-
+# 2. fullbench -F raises itself to SCHED_FIFO (or nice -20 when refused).
+# 3. fullbench reads the governor, turbo state and frequency, warns when they
+#    make the results noisy and records them with the results.  Set the
+#    governor to performance beforehand, and add -S to refuse noisy runs.
 # 4. Try not to run anything while the test is underway and have enough memory to hold both the
 #    uncompressed and compressed image (*2) in ram.
 #
-# You may need to run as ROOT for 1,2 and 3 to be effective.
+# You may need to run as ROOT (or with CAP_SYS_NICE) for 2 to be effective.
 #
 # The benchmark attempts to eliminate any IO during the timing so the
 # RAW performance for the compressor/de-compressor can be measured.
@@ -53,18 +47,12 @@ done
 TESTDIR="../test-files"
 TESTFILES=../test-files/silesia/mozilla
 
-#taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B1 -C048 -D0567 ${TESTFILES} 2> >(tee run-1K.out >&2)
-#taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B2 -C048 -D0567 ${TESTFILES} 2> >(tee run-4K.out >&2)
-#taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B3 -C048 -D0567 ${TESTFILES} 2> >(tee run-16K.out >&2)
-#taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B4 -C048 -D0567 ${TESTFILES} 2> >(tee run-64K.out >&2)
-#taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B5 -C048 -D0567 ${TESTFILES} 2> >(tee run-256K.out >&2)
-#taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B6 -C048 -D0567 ${TESTFILES} 2> >(tee run-1M.out >&2)
-taskset -c ${CORE} nice -n ${PRIO} ./fullbenchK -B7 -d ${TESTFILES}
-
-# Put the governor back to "ondemand" the likely initial default.  Change this if you dont like it.
-echo ondemand | tee /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor >/dev/null
-echo "Cores are re-set to:"
-for gov in `ls /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor`; do
-  scale=`cat ${gov}`
-  echo ${gov} = ${scale}
-done
+#./fullbench$1 -P${CORE} -F -B1 -C048 -D0567 ${TESTFILES} 2> >(tee run-1K.out >&2)
+#./fullbench$1 -P${CORE} -F -B2 -C048 -D0567 ${TESTFILES} 2> >(tee run-4K.out >&2)
+#./fullbench$1 -P${CORE} -F -B3 -C048 -D0567 ${TESTFILES} 2> >(tee run-16K.out >&2)
+#./fullbench$1 -P${CORE} -F -B4 -C048 -D0567 ${TESTFILES} 2> >(tee run-64K.out >&2)
+#./fullbench$1 -P${CORE} -F -B5 -C048 -D0567 ${TESTFILES} 2> >(tee run-256K.out >&2)
+#./fullbench$1 -P${CORE} -F -B6 -C048 -D0567 ${TESTFILES} 2> >(tee run-1M.out >&2)
+./fullbenchK -P${CORE} -F -B7 -d ${TESTFILES}
+# Decode only, one decoder : its reference streams must not depend on a compressor having run
+./fullbench$1 -i1 -d1 ${TESTFILES}
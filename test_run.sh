@@ -11,7 +11,8 @@
 # LZJB Decompression as used in ZFS on linux.
 # LZJB Decompression as used in ZFS on bsd.
 # New LZJB Decompression routine.
-# Each block size from 1K-4M will be tested and the results saved.
+# Each block size from 1K-4M will be tested in a single run, each file being
+# loaded once, and the results saved with a combined table per file.
 # NOTE: ZFS lzjb will not compress with blocks of 512K.
 #       Which is why that block size is not tested.
 
@@ -23,22 +24,16 @@
 # 4. Running out of memory.
 #
 # Fixes for these:
-# 1. Use taskset to set processor affinity to lock us to a core and its attendant caches.
+# 1. fullbench -P pins itself to a core and its attendant caches.
 CORE="1"
-# 2. Use nice to give the highest sheduling priority we can
-PRIO="-20"
-# 3. This changes the governor to performance, which maximizes the cpu core frequency.
-echo performance | tee /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor >/dev/null
-echo "Cores are set to:"
-for gov in `ls /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor`; do
-  scale=`cat ${gov}`
-  echo ${gov} = ${scale}
-done
-
+# 2. fullbench -F raises itself to SCHED_FIFO (or nice -20 when refused).
+# 3. fullbench reads the governor, turbo state and frequency, warns when they
+#    make the results noisy and records them with the results.  Set the
+#    governor to performance beforehand, and add -S to refuse noisy runs.
 # 4. Try not to run anything while the test is underway and have enough memory to hold both the
 #    uncompressed and compressed image (*2) in ram.
 #
-# You may need to run as ROOT for 1,2 and 3 to be effective.
+# You may need to run as ROOT (or with CAP_SYS_NICE) for 2 to be effective.
 #
 # The benchmark attempts to eliminate any IO during the timing so the
 # RAW performance for the compressor/de-compressor can be measured.
@@ -53,18 +48,4 @@ done
 TESTDIR="../test-files"
 TESTFILES=$(find $TESTDIR -type f -iname "*" -print | sort | tr \\n ' ')
 
-taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B1 -C048 -D0567 ${TESTFILES} 2> >(tee run-1K.out >&2)
-taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B2 -C048 -D0567 ${TESTFILES} 2> >(tee run-4K.out >&2)
-taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B3 -C048 -D0567 ${TESTFILES} 2> >(tee run-16K.out >&2)
-taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B4 -C048 -D0567 ${TESTFILES} 2> >(tee run-64K.out >&2)
-taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B5 -C048 -D0567 ${TESTFILES} 2> >(tee run-256K.out >&2)
-taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B6 -C048 -D0567 ${TESTFILES} 2> >(tee run-1M.out >&2)
-taskset -c ${CORE} nice -n ${PRIO} ./fullbench$1 -B7 -C048 -D0567 ${TESTFILES} 2> >(tee run-4M.out >&2)
-
-# Put the governor back to "ondemand" the likely initial default.  Change this if you dont like it.
-echo ondemand | tee /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor >/dev/null
-echo "Cores are re-set to:"
-for gov in `ls /sys/devices/system/cpu/cpu*/cpufreq/scaling_governor`; do
-  scale=`cat ${gov}`
-  echo ${gov} = ${scale}
-done
+./fullbench$1 -P${CORE} -F -B1K,4K,16K,64K,256K,1M,4M -C048 -D0567 ${TESTFILES} 2> >(tee run-sweep.out >&2)